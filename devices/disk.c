@@ -1,12 +1,14 @@
 #include "devices/disk.h"
 #include <ctype.h>
 #include <debug.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/trace.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -59,6 +61,10 @@ struct disk {
 
 	long long read_cnt;         /* Number of sectors read. */
 	long long write_cnt;        /* Number of sectors written. */
+	int64_t read_ns;            /* Total time taken by reads. */
+	int64_t write_ns;           /* Total time taken by writes. */
+	int64_t read_max_ns;        /* Longest read. */
+	int64_t write_max_ns;       /* Longest write. */
 };
 
 /* An ATA channel (aka controller).
@@ -134,6 +140,8 @@ disk_init (void) {
 			d->capacity = 0;
 
 			d->read_cnt = d->write_cnt = 0;
+			d->read_ns = d->write_ns = 0;
+			d->read_max_ns = d->write_max_ns = 0;
 		}
 
 		/* Register interrupt handler. */
@@ -166,9 +174,20 @@ disk_print_stats (void) {
 
 		for (dev_no = 0; dev_no < 2; dev_no++) {
 			struct disk *d = disk_get (chan_no, dev_no);
-			if (d != NULL && d->is_ata)
+			if (d != NULL && d->is_ata) {
 				printf ("%s: %lld reads, %lld writes\n",
 						d->name, d->read_cnt, d->write_cnt);
+				if (d->read_cnt > 0)
+					printf ("%s: reads took %"PRId64" us on average, "
+							"%"PRId64" us at most\n", d->name,
+							d->read_ns / d->read_cnt / 1000,
+							d->read_max_ns / 1000);
+				if (d->write_cnt > 0)
+					printf ("%s: writes took %"PRId64" us on average, "
+							"%"PRId64" us at most\n", d->name,
+							d->write_ns / d->write_cnt / 1000,
+							d->write_max_ns / 1000);
+			}
 		}
 	}
 }
@@ -203,6 +222,24 @@ disk_size (struct disk *d) {
 	return d->capacity;
 }
 
+/* Returns a number for D, CHAN_NO * 2 + DEV_NO, to tell disks
+   apart in traces. */
+static int
+disk_id (const struct disk *d) {
+	return (d->channel - channels) * 2 + d->dev_no;
+}
+
+/* Adds the time since START, as returned by timer_now_ns(), to the
+   total in *TOTAL and, if it is the longest yet, records it in *MAX. */
+static void
+account_latency (int64_t *total, int64_t *max, int64_t start) {
+	int64_t elapsed = timer_now_ns () - start;
+
+	*total += elapsed;
+	if (elapsed > *max)
+		*max = elapsed;
+}
+
 /* Reads sector SEC_NO from disk D into BUFFER, which must have
    room for DISK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to disks, so external
@@ -210,12 +247,15 @@ disk_size (struct disk *d) {
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
 	struct channel *c;
+	int64_t start;
 
 	ASSERT (d != NULL);
 	ASSERT (buffer != NULL);
 
 	c = d->channel;
 	lock_acquire (&c->lock);
+	TRACE (TRACE_DISK_READ, sec_no, disk_id (d));
+	start = timer_now_ns ();
 	select_sector (d, sec_no);
 	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
 	sema_down (&c->completion_wait);
@@ -223,6 +263,8 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
 		PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
 	input_sector (c, buffer);
 	d->read_cnt++;
+	account_latency (&d->read_ns, &d->read_max_ns, start);
+	TRACE (TRACE_DISK_DONE, sec_no, disk_id (d));
 	lock_release (&c->lock);
 }
 
@@ -234,12 +276,15 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
 void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
 	struct channel *c;
+	int64_t start;
 
 	ASSERT (d != NULL);
 	ASSERT (buffer != NULL);
 
 	c = d->channel;
 	lock_acquire (&c->lock);
+	TRACE (TRACE_DISK_WRITE, sec_no, disk_id (d));
+	start = timer_now_ns ();
 	select_sector (d, sec_no);
 	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
 	if (!wait_while_busy (d))
@@ -247,6 +292,8 @@ disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
 	output_sector (c, buffer);
 	sema_down (&c->completion_wait);
 	d->write_cnt++;
+	account_latency (&d->write_ns, &d->write_max_ns, start);
+	TRACE (TRACE_DISK_DONE, sec_no, disk_id (d));
 	lock_release (&c->lock);
 }
 
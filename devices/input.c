@@ -4,12 +4,14 @@
 #include "devices/serial.h"
 
 /* Stores keys from the keyboard and serial port. */
+#define BUFFER_SIZE 256
+static uint8_t buffer_bytes[BUFFER_SIZE];
 static struct intq buffer;
 
 /* Initializes the input buffer. */
 void
 input_init (void) {
-	intq_init (&buffer);
+	intq_init (&buffer, buffer_bytes, sizeof buffer_bytes);
 }
 
 /* Adds a key to the input buffer.
@@ -1,105 +1,174 @@
 #include "devices/intq.h"
 #include <debug.h>
+#include <string.h>
+#include "threads/synch.h"
 #include "threads/thread.h"
 
-static int next (int pos);
-static void wait (struct intq *q, struct thread **waiter);
-static void signal (struct intq *q, struct thread **waiter);
+static size_t load_acquire (const size_t *);
+static void store_release (size_t *, size_t);
+static void wait (struct list *waiters);
+static void signal (struct list *waiters);
 
-/* Initializes interrupt queue Q. */
+/* Initializes interrupt queue Q to hold its bytes in the SIZE
+   bytes at BUF.  SIZE must be a power of two. */
 void
-intq_init (struct intq *q) {
-	lock_init (&q->lock);
-	q->not_full = q->not_empty = NULL;
+intq_init (struct intq *q, void *buf, size_t size) {
+	ASSERT (buf != NULL);
+	ASSERT (size > 0 && (size & (size - 1)) == 0);
+
+	q->buf = buf;
+	q->size = size;
 	q->head = q->tail = 0;
+	list_init (&q->not_full);
+	list_init (&q->not_empty);
+}
+
+/* Returns the number of bytes in Q. */
+size_t
+intq_count (const struct intq *q) {
+	return load_acquire (&q->head) - load_acquire (&q->tail);
 }
 
 /* Returns true if Q is empty, false otherwise. */
 bool
 intq_empty (const struct intq *q) {
-	ASSERT (intr_get_level () == INTR_OFF);
-	return q->head == q->tail;
+	return intq_count (q) == 0;
 }
 
 /* Returns true if Q is full, false otherwise. */
 bool
 intq_full (const struct intq *q) {
-	ASSERT (intr_get_level () == INTR_OFF);
-	return next (q->head) == q->tail;
+	return intq_count (q) == q->size;
+}
+
+/* Adds up to SIZE bytes from BUF to the end of Q, as many as
+   there is room for, without sleeping.  Returns the number of
+   bytes added. */
+size_t
+intq_put (struct intq *q, const void *buf_, size_t size) {
+	const uint8_t *buf = buf_;
+	size_t head = q->head;
+	size_t room = q->size - (head - load_acquire (&q->tail));
+	size_t ofs = head & (q->size - 1);
+	size_t first;
+
+	if (size > room)
+		size = room;
+	if (size == 0)
+		return 0;
+
+	first = size < q->size - ofs ? size : q->size - ofs;
+	memcpy (q->buf + ofs, buf, first);
+	memcpy (q->buf, buf + first, size - first);
+	store_release (&q->head, head + size);
+	signal (&q->not_empty);
+	return size;
+}
+
+/* Removes up to SIZE bytes from the front of Q into BUF, as many
+   as there are, without sleeping.  Returns the number of bytes
+   removed. */
+size_t
+intq_get (struct intq *q, void *buf_, size_t size) {
+	uint8_t *buf = buf_;
+	size_t tail = q->tail;
+	size_t count = load_acquire (&q->head) - tail;
+	size_t ofs = tail & (q->size - 1);
+	size_t first;
+
+	if (size > count)
+		size = count;
+	if (size == 0)
+		return 0;
+
+	first = size < q->size - ofs ? size : q->size - ofs;
+	memcpy (buf, q->buf + ofs, first);
+	memcpy (buf + first, q->buf, size - first);
+	store_release (&q->tail, tail + size);
+	signal (&q->not_full);
+	return size;
+}
+
+/* Sleeps until Q is not full.  Must be called from a kernel
+   thread with interrupts off. */
+void
+intq_wait_not_full (struct intq *q) {
+	while (intq_full (q))
+		wait (&q->not_full);
+}
+
+/* Sleeps until Q is not empty.  Must be called from a kernel
+   thread with interrupts off. */
+void
+intq_wait_not_empty (struct intq *q) {
+	while (intq_empty (q))
+		wait (&q->not_empty);
 }
 
 /* Removes a byte from Q and returns it.
    Q must not be empty if called from an interrupt handler.
    Otherwise, if Q is empty, first sleeps until a byte is
-   added. */
+   added, which requires interrupts to be off. */
 uint8_t
 intq_getc (struct intq *q) {
 	uint8_t byte;
 
-	ASSERT (intr_get_level () == INTR_OFF);
-	while (intq_empty (q)) {
-		ASSERT (!intr_context ());
-		lock_acquire (&q->lock);
-		wait (q, &q->not_empty);
-		lock_release (&q->lock);
-	}
-
-	byte = q->buf[q->tail];
-	q->tail = next (q->tail);
-	signal (q, &q->not_full);
+	while (intq_get (q, &byte, 1) == 0)
+		intq_wait_not_empty (q);
 	return byte;
 }
 
 /* Adds BYTE to the end of Q.
    Q must not be full if called from an interrupt handler.
    Otherwise, if Q is full, first sleeps until a byte is
-   removed. */
+   removed, which requires interrupts to be off. */
 void
 intq_putc (struct intq *q, uint8_t byte) {
-	ASSERT (intr_get_level () == INTR_OFF);
-	while (intq_full (q)) {
-		ASSERT (!intr_context ());
-		lock_acquire (&q->lock);
-		wait (q, &q->not_full);
-		lock_release (&q->lock);
-	}
-
-	q->buf[q->head] = byte;
-	q->head = next (q->head);
-	signal (q, &q->not_empty);
+	while (intq_put (q, &byte, 1) == 0)
+		intq_wait_not_full (q);
 }
 
-/* Returns the position after POS within an intq. */
-static int
-next (int pos) {
-	return (pos + 1) % INTQ_BUFSIZE;
+/* Returns *P, reading it before anything the caller reads
+   afterward. */
+static size_t
+load_acquire (const size_t *p) {
+	return __atomic_load_n (p, __ATOMIC_ACQUIRE);
 }
 
-/* WAITER must be the address of Q's not_empty or not_full
-   member.  Waits until the given condition is true. */
+/* Sets *P to VALUE, after everything the caller wrote before. */
 static void
-wait (struct intq *q UNUSED, struct thread **waiter) {
+store_release (size_t *p, size_t value) {
+	__atomic_store_n (p, value, __ATOMIC_RELEASE);
+}
+
+/* Adds the current thread to WAITERS, one of an intq's wait
+   lists, and sleeps until it is woken. */
+static void
+wait (struct list *waiters) {
 	ASSERT (!intr_context ());
 	ASSERT (intr_get_level () == INTR_OFF);
-	ASSERT ((waiter == &q->not_empty && intq_empty (q))
-			|| (waiter == &q->not_full && intq_full (q)));
 
-	*waiter = thread_current ();
+	list_push_back (waiters, &thread_current ()->elem);
 	thread_block ();
 }
 
-/* WAITER must be the address of Q's not_empty or not_full
-   member, and the associated condition must be true.  If a
-   thread is waiting for the condition, wakes it up and resets
-   the waiting thread. */
+/* Wakes every thread in WAITERS, one of an intq's wait lists. */
 static void
-signal (struct intq *q UNUSED, struct thread **waiter) {
-	ASSERT (intr_get_level () == INTR_OFF);
-	ASSERT ((waiter == &q->not_empty && !intq_empty (q))
-			|| (waiter == &q->not_full && !intq_full (q)));
+signal (struct list *waiters) {
+	enum intr_level old_level;
+
+	/* Peeking without turning interrupts off is fine: a thread
+	   only goes to sleep after finding the queue full or empty
+	   with interrupts off, so it is on the list before the index
+	   that would have kept it awake was published.  The barrier
+	   keeps the peek after that. */
+	barrier ();
+	if (list_empty (waiters))
+		return;
 
-	if (*waiter != NULL) {
-		thread_unblock (*waiter);
-		*waiter = NULL;
-	}
+	old_level = intr_disable ();
+	while (!list_empty (waiters))
+		thread_unblock (list_entry (list_pop_front (waiters),
+					struct thread, elem));
+	intr_set_level (old_level);
 }
@@ -41,6 +41,13 @@
 #define LCR_N81 0x03            /* No parity, 8 data bits, 1 stop bit. */
 #define LCR_DLAB 0x80           /* Divisor Latch Access Bit (DLAB). */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable the FIFOs. */
+#define FCR_CLEAR 0x06          /* Clear both FIFOs. */
+
+/* Bytes the transmit FIFO holds. */
+#define XMIT_FIFO_SIZE 16
+
 /* MODEM Control Register. */
 #define MCR_OUT2 0x08           /* Output line 2. */
 
@@ -51,7 +58,13 @@
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
+/* Data to be transmitted.  The queue is big enough that a
+   process writing to the console a page at a time hands its
+   output over and carries on instead of waiting for the port,
+   which at 115.2 kbps takes most of a second to send this
+   much. */
+#define TXQ_SIZE 8192
+static uint8_t txq_bytes[TXQ_SIZE];
 static struct intq txq;
 
 static void set_serial (int bps);
@@ -70,7 +83,7 @@ init_poll (void) {
 	outb (FCR_REG, 0);                    /* Disable FIFO. */
 	set_serial (115200);                  /* 115.2 kbps, N-8-1. */
 	outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-	intq_init (&txq);
+	intq_init (&txq, txq_bytes, sizeof txq_bytes);
 	mode = POLL;
 }
 
@@ -88,6 +101,7 @@ serial_init_queue (void) {
 	intr_register_ext (0x20 + 4, serial_interrupt, "serial");
 	mode = QUEUE;
 	old_level = intr_disable ();
+	outb (FCR_REG, FCR_ENABLE | FCR_CLEAR);
 	write_ier ();
 	intr_set_level (old_level);
 }
@@ -95,28 +109,47 @@ serial_init_queue (void) {
 /* Sends BYTE to the serial port. */
 void
 serial_putc (uint8_t byte) {
+	serial_putbuf (&byte, 1);
+}
+
+/* Sends the SIZE bytes in BUF to the serial port.  Returns once
+   they are all queued for transmission, which unless the queue
+   is backed up is right away. */
+void
+serial_putbuf (const void *buf_, size_t size) {
+	const uint8_t *buf = buf_;
 	enum intr_level old_level = intr_disable ();
 
 	if (mode != QUEUE) {
 		/* If we're not set up for interrupt-driven I/O yet,
-		   use dumb polling to transmit a byte. */
+		   use dumb polling to transmit. */
 		if (mode == UNINIT)
 			init_poll ();
-		putc_poll (byte);
+		while (size-- > 0)
+			putc_poll (*buf++);
 	} else {
-		/* Otherwise, queue a byte and update the interrupt enable
-		   register. */
-		if (old_level == INTR_OFF && intq_full (&txq)) {
-			/* Interrupts are off and the transmit queue is full.
-			   If we wanted to wait for the queue to empty,
-			   we'd have to reenable interrupts.
-			   That's impolite, so we'll send a character via
-			   polling instead. */
-			putc_poll (intq_getc (&txq));
+		/* Otherwise, queue as much as fits at once and update the
+		   interrupt enable register. */
+		while (size > 0) {
+			size_t n = intq_put (&txq, buf, size);
+
+			if (n == 0) {
+				if (old_level == INTR_OFF) {
+					/* Interrupts are off and the transmit queue is
+					   full.  If we wanted to wait for the queue to
+					   empty, we'd have to reenable interrupts.
+					   That's impolite, so we'll send a character
+					   via polling instead. */
+					putc_poll (intq_getc (&txq));
+				} else
+					intq_wait_not_full (&txq);
+				continue;
+			}
+
+			buf += n;
+			size -= n;
+			write_ier ();
 		}
-
-		intq_putc (&txq, byte);
-		write_ier ();
 	}
 
 	intr_set_level (old_level);
@@ -205,10 +238,14 @@ serial_interrupt (struct intr_frame *f UNUSED) {
 	while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
 		input_putc (inb (RBR_REG));
 
-	/* As long as we have a byte to transmit, and the hardware is
-	   ready to accept a byte for transmission, transmit a byte. */
-	while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0)
-		outb (THR_REG, intq_getc (&txq));
+	/* If the transmit FIFO is empty, refill it from the queue. */
+	if ((inb (LSR_REG) & LSR_THRE) != 0) {
+		uint8_t fifo[XMIT_FIFO_SIZE];
+		size_t i, n = intq_get (&txq, fifo, sizeof fifo);
+
+		for (i = 0; i < n; i++)
+			outb (THR_REG, fifo[i]);
+	}
 
 	/* Update interrupt enable register based on queue status. */
 	write_ier ();
@@ -5,8 +5,10 @@
 #include <stdio.h>
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/profile.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -20,24 +22,101 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Nanoseconds per timer tick. */
+#define NS_PER_TICK (1000 * 1000 * 1000 / TIMER_FREQ)
+
+/* The local APIC timer.
+
+   When the CPU has a local APIC, its timer replaces the 8254 as the
+   source of timer interrupts, in one-shot mode: each interrupt is
+   programmed for when the next thing is due, which is the earlier of
+   the next timer tick and the earliest sleeping thread's wakeup.
+   While the idle thread runs, there is nothing for a tick to do, so
+   the timer is programmed for the next wakeup only and the ticks
+   missed meanwhile are caught up on when the CPU goes back to work.
+   A sleep need not end on a tick either, so timer_usleep() and
+   timer_nsleep() block like timer_sleep() does instead of spinning.
+
+   Without a TSC (see below), the timer also keeps time.  It counts
+   down from the count it was programmed with, so the time is that of
+   the last programming plus the part of the count already gone.  A
+   single count is kept under ARM_MAX_NS, well short of the 32-bit
+   counter overflowing, which also keeps the timer running while
+   idle with no one asleep.  With a TSC to keep time, the timer is
+   simply stopped then. */
+
+/* Local APIC timer registers, by byte offset, and their bits. */
+#define LAPIC_TIMER 0x320           /* Local vector table: timer. */
+#define LAPIC_TIMER_MASKED 0x10000  /* Interrupt masked. */
+#define LAPIC_TIMER_INIT 0x380      /* Initial count. */
+#define LAPIC_TIMER_CUR 0x390       /* Current count. */
+#define LAPIC_TIMER_DIV 0x3e0       /* Divide configuration. */
+#define LAPIC_TIMER_DIV16 0x3       /* Count at 1/16 of the bus clock. */
+
+/* Local APIC timer interrupt vector. */
+#define LAPIC_TIMER_VEC 0x30
+
+/* 8254 input frequency. */
+#define PIT_HZ 1193182
+
+/* Longest the local APIC timer is programmed for at once. */
+#define ARM_MAX_NS (1000 * 1000 * 1000)
+
+/* Shortest sleep worth blocking for.  Shorter ones busy-wait. */
+#define SLEEP_MIN_NS (20 * 1000)
+
+/* The time stamp counter.
+
+   timer_now_ns() reads the time off the CPU's time stamp counter,
+   whose rate is measured against the 8254 at boot along with the
+   local APIC timer's.  Cycles are converted to nanoseconds with a
+   multiply and a shift rather than a division: TSC_MULT is the
+   number of nanoseconds per cycle in 32.32 fixed point.  Without a
+   TSC, the time only advances a tick at a time. */
+
+#define CPUID_TSC (1U << 4)         /* CPUID.1:EDX: TSC present. */
+
+static uint64_t tsc_hz;         /* Cycles per second, or 0 if unused. */
+static uint64_t tsc_mult;       /* Nanoseconds per cycle, times 2**32. */
+static uint64_t tsc_start;      /* TSC when it was calibrated. */
+
+static uint64_t lapic_hz;       /* Counts per second, or 0 if unused. */
+static int64_t clock_base;      /* Time, in ns, of the last programming. */
+static uint32_t armed_count;    /* Count it was programmed with. */
+static int64_t armed_until;     /* When it will go off, in ns. */
+static bool idle_mode;          /* Programmed for wakeups only? */
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
 static intr_handler_func timer_interrupt;
+static intr_handler_func lapic_timer_interrupt;
+static void calibrate (void);
+static bool lapic_timer_init (void);
+static int64_t clock_now (void);
+static void clock_arm (int64_t until);
+static void sleep_until (int64_t until);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 
-/* Sets up the 8254 Programmable Interval Timer (PIT) to
-   interrupt PIT_FREQ times per second, and registers the
-   corresponding interrupt. */
+/* Sets up the local APIC timer, if there is one, or else the 8254
+   Programmable Interval Timer (PIT) to interrupt PIT_FREQ times per
+   second, and registers the corresponding interrupt. */
 void
 timer_init (void) {
 	/* 8254 input frequency divided by TIMER_FREQ, rounded to
 	   nearest. */
 	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
 
+	calibrate ();
+	if (lapic_timer_init ()) {
+		/* Leave counter 0 waiting for a count that never comes. */
+		outb (0x43, 0x30);    /* CW: counter 0, LSB then MSB, mode 0, binary. */
+		return;
+	}
+
 	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
 	outb (0x40, count & 0xff);
 	outb (0x40, count >> 8);
@@ -70,6 +149,165 @@ timer_calibrate (void) {
 	printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
 }
 
+/* Measures the rates of the TSC and the local APIC timer, those of
+   them the CPU has, against the 8254. */
+static void
+calibrate (void) {
+	/* 8254 counts in 10 ms. */
+	const uint16_t count = PIT_HZ / 100;
+	bool lapic = lapic_present ();
+	uint32_t regs[4];
+	uint64_t tsc;
+	uint32_t elapsed;
+
+	cpuid (1, 0, regs);
+
+	/* Count the local APIC timer down, and the TSC up, while
+	   counter 2 of the 8254, whose output can be read back from port
+	   0x61, runs out. */
+	if (lapic) {
+		lapic_write (LAPIC_TIMER_DIV, LAPIC_TIMER_DIV16);
+		lapic_write (LAPIC_TIMER, LAPIC_TIMER_MASKED | LAPIC_TIMER_VEC);
+	}
+	outb (0x61, (inb (0x61) & ~0x02) | 0x01);    /* Gate on, speaker off. */
+	outb (0x43, 0xb0);    /* CW: counter 2, LSB then MSB, mode 0, binary. */
+	outb (0x42, count & 0xff);
+	outb (0x42, count >> 8);
+	if (lapic)
+		lapic_write (LAPIC_TIMER_INIT, UINT32_MAX);
+	tsc = rdtsc ();
+	while (!(inb (0x61) & 0x20))
+		continue;
+	tsc = rdtsc () - tsc;
+	if (lapic) {
+		elapsed = UINT32_MAX - lapic_read (LAPIC_TIMER_CUR);
+		lapic_write (LAPIC_TIMER_INIT, 0);
+		lapic_hz = (uint64_t) elapsed * PIT_HZ / count;
+	}
+
+	if ((regs[3] & CPUID_TSC) && tsc > 0) {
+		tsc_hz = tsc * PIT_HZ / count;
+		tsc_mult = (1000000000ULL << 32) / tsc_hz;
+		tsc_start = rdtsc ();
+	}
+}
+
+/* Starts the local APIC timer.  Returns false if there is no local
+   APIC. */
+static bool
+lapic_timer_init (void) {
+	if (lapic_hz == 0)
+		return false;
+
+	intr_register_ext (LAPIC_TIMER_VEC, lapic_timer_interrupt,
+			"Local APIC Timer");
+	lapic_write (LAPIC_TIMER, LAPIC_TIMER_VEC);
+	clock_base = 0;
+	armed_count = 0;
+	clock_arm (NS_PER_TICK);
+	return true;
+}
+
+/* Returns the rate of the time stamp counter in Hz, or 0 if it
+   is not known. */
+uint64_t
+timer_tsc_hz (void) {
+	return tsc_hz;
+}
+
+/* Returns the time since the timer started, in nanoseconds. */
+int64_t
+timer_now_ns (void) {
+	uint64_t cycles;
+
+	if (tsc_hz == 0) {
+		enum intr_level old_level = intr_disable ();
+		int64_t now = clock_now ();
+		intr_set_level (old_level);
+		return now;
+	}
+	cycles = rdtsc () - tsc_start;
+	return ((unsigned __int128) cycles * tsc_mult) >> 32;
+}
+
+/* Returns the time since the timer started, in nanoseconds, as the
+   timer itself keeps it.  Interrupts must be off. */
+static int64_t
+clock_now (void) {
+	uint32_t gone;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (tsc_hz != 0)
+		return timer_now_ns ();
+	if (lapic_hz == 0)
+		return ticks * NS_PER_TICK;
+	gone = armed_count - lapic_read (LAPIC_TIMER_CUR);
+	return clock_base + (int64_t) ((uint64_t) gone * 1000000000 / lapic_hz);
+}
+
+/* Programs the local APIC timer to go off at time UNTIL, in
+   nanoseconds, or in ARM_MAX_NS if that is sooner.  Interrupts must
+   be off. */
+static void
+clock_arm (int64_t until) {
+	int64_t now = clock_now ();
+	int64_t delta = until - now;
+	uint64_t count;
+
+	if (until == INT64_MAX && tsc_hz != 0) {
+		/* Nothing is due. */
+		armed_until = INT64_MAX;
+		lapic_write (LAPIC_TIMER_INIT, 0);
+		return;
+	}
+	if (delta > ARM_MAX_NS)
+		delta = ARM_MAX_NS;
+	count = delta > 0 ? (uint64_t) delta * lapic_hz / 1000000000 : 0;
+	if (count == 0)
+		count = 1;
+
+	clock_base = now;
+	armed_count = count;
+	armed_until = now + delta;
+	lapic_write (LAPIC_TIMER_INIT, count);
+}
+
+/* Programs the local APIC timer for whatever is due next: the next
+   wakeup, and unless the CPU is idle, the next tick.  Interrupts
+   must be off. */
+static void
+clock_arm_next (void) {
+	int64_t until = thread_next_wakeup ();
+
+	if (!idle_mode && until > (ticks + 1) * NS_PER_TICK)
+		until = (ticks + 1) * NS_PER_TICK;
+	clock_arm (until);
+}
+
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU.  Stops the timer ticking until timer_idle_exit(). */
+void
+timer_idle_enter (void) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (lapic_hz == 0)
+		return;
+	idle_mode = true;
+	clock_arm_next ();
+}
+
+/* Called, with interrupts off, when the scheduler switches from the
+   idle thread to another.  Starts the timer ticking again, counting
+   the ticks that went by without a timer interrupt. */
+void
+timer_idle_exit (void) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (lapic_hz == 0 || !idle_mode)
+		return;
+	ticks = clock_now () / NS_PER_TICK;
+	idle_mode = false;
+	clock_arm_next ();
+}
+
 /* Returns the number of timer ticks since the OS booted. */
 int64_t
 timer_ticks (void) {
@@ -100,7 +338,7 @@ timer_sleep (int64_t ticks) {
 	int64_t wakeup_tick=timer_ticks() + ticks;
 
 	ASSERT (intr_get_level () == INTR_ON);
-	thread_sleep(wakeup_tick);
+	sleep_until(wakeup_tick * NS_PER_TICK);
 }
 
 /* Suspends execution for approximately MS milliseconds. */
@@ -125,15 +363,68 @@ timer_nsleep (int64_t ns) {
 void
 timer_print_stats (void) {
 	printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+	if (tsc_hz != 0)
+		printf ("Timer: TSC at %"PRIu64" kHz\n", tsc_hz / 1000);
+}
+
+/* Starts the 8254 PIT interrupting HZ times per second, calling
+   HANDLER each time, for the profiler to sample with.  Returns
+   false if the PIT is driving the timer itself. */
+bool
+timer_start_sampler (int hz, intr_handler_func *handler) {
+	uint16_t count;
+
+	ASSERT (hz > TIMER_FREQ && hz <= 10000);
+	if (lapic_hz == 0)
+		return false;
+
+	count = (PIT_HZ + hz / 2) / hz;
+	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
+	outb (0x40, count & 0xff);
+	outb (0x40, count >> 8);
+	intr_register_ext (0x20, handler, "8254 Sampler");
+	return true;
 }
 
 /* Timer interrupt handler. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED) {
+timer_interrupt (struct intr_frame *args) {
 	ticks++;
 	thread_tick ();
+	profile_tick (args, 1);
 
-	check_sleep_list(ticks);
+	check_sleep_list(ticks * NS_PER_TICK);
+}
+
+/* Local APIC timer interrupt handler.  Runs the ticks that are due,
+   which after an idle spell may be several, wakes the threads whose
+   time has come, and programs the next interrupt. */
+static void
+lapic_timer_interrupt (struct intr_frame *args) {
+	int64_t now = clock_now ();
+	int tick_cnt = 0;
+
+	while (now >= (ticks + 1) * NS_PER_TICK) {
+		ticks++;
+		tick_cnt++;
+		thread_tick ();
+	}
+	profile_tick (args, tick_cnt);
+	check_sleep_list (now);
+	clock_arm_next ();
+}
+
+/* Puts the current thread to sleep until time UNTIL, in
+   nanoseconds, moving the timer interrupt earlier if it would
+   otherwise come too late to wake it. */
+static void
+sleep_until (int64_t until) {
+	enum intr_level old_level = intr_disable ();
+
+	if (lapic_hz != 0 && until < armed_until)
+		clock_arm (until);
+	thread_sleep (until);
+	intr_set_level (old_level);
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -170,6 +461,32 @@ busy_wait (int64_t loops) {
 /* Sleep for approximately NUM/DENOM seconds. */
 static void
 real_time_sleep (int64_t num, int32_t denom) {
+	if (lapic_hz != 0) {
+		/* The local APIC timer can wake us at any time, so block
+		   unless the sleep is too short to be worth a context
+		   switch. */
+		int64_t ns = num * (1000 * 1000 * 1000 / denom);
+		enum intr_level old_level;
+		int64_t now;
+
+		ASSERT (intr_get_level () == INTR_ON);
+		if (ns >= SLEEP_MIN_NS) {
+			old_level = intr_disable ();
+			now = clock_now ();
+			intr_set_level (old_level);
+			sleep_until (now + ns);
+			return;
+		}
+	}
+	if (tsc_hz != 0 && num * TIMER_FREQ / denom == 0) {
+		/* Spin on the TSC, which beats counting loops. */
+		int64_t until = timer_now_ns () + num * (1000 * 1000 * 1000 / denom);
+
+		while (timer_now_ns () < until)
+			barrier ();
+		return;
+	}
+
 	/* Convert NUM/DENOM seconds into timer ticks, rounding down.
 
 	   (NUM / DENOM) s
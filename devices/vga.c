@@ -7,7 +7,14 @@
 #include "threads/interrupt.h"
 #include "threads/vaddr.h"
 
-/* VGA text screen support.  See [FREEVGA] for more information. */
+/* VGA text screen support.  See [FREEVGA] for more information.
+
+   Text is drawn into a shadow copy of the screen in ordinary
+   memory, and rows that changed are copied out to the
+   framebuffer, and the hardware cursor moved, once per call
+   rather than once per character.  Scrolling in particular
+   never reads the framebuffer, which is slow to read on real
+   hardware. */
 
 /* Number of columns and rows on the text display. */
 #define COL_CNT 80
@@ -25,6 +32,14 @@ static size_t cx, cy;
    The attribute at (x,y) is fb[y][x][1]. */
 static uint8_t (*fb)[COL_CNT][2];
 
+/* Shadow of the framebuffer, drawn into by vga_putbuf().
+   Rows DIRTY_LO up to DIRTY_HI differ from FB. */
+static uint8_t shadow[ROW_CNT][COL_CNT][2];
+static size_t dirty_lo, dirty_hi;
+
+static void putc_shadow (int c);
+static void mark_dirty (size_t y);
+static void flush (void);
 static void clear_row (size_t y);
 static void cls (void);
 static void newline (void);
@@ -38,6 +53,9 @@ init (void) {
 	static bool inited;
 	if (!inited) {
 		fb = ptov (0xb8000);
+		memcpy (shadow, fb, sizeof shadow);
+		dirty_lo = ROW_CNT;
+		dirty_hi = 0;
 		find_cursor (&cx, &cy);
 		inited = true;
 	}
@@ -47,12 +65,29 @@ init (void) {
    characters in the conventional ways.  */
 void
 vga_putc (int c) {
+	char ch = c;
+	vga_putbuf (&ch, 1);
+}
+
+/* Writes the SIZE characters in BUF to the VGA text display,
+   interpreting control characters as vga_putc() does. */
+void
+vga_putbuf (const char *buf, size_t size) {
 	/* Disable interrupts to lock out interrupt handlers
 	   that might write to the console. */
 	enum intr_level old_level = intr_disable ();
 
 	init ();
+	while (size-- > 0)
+		putc_shadow ((uint8_t) *buf++);
+	flush ();
 
+	intr_set_level (old_level);
+}
+
+/* Draws C into the shadow screen. */
+static void
+putc_shadow (int c) {
 	switch (c) {
 		case '\n':
 			newline ();
@@ -78,19 +113,36 @@ vga_putc (int c) {
 			break;
 
 		default:
-			fb[cy][cx][0] = c;
-			fb[cy][cx][1] = GRAY_ON_BLACK;
+			shadow[cy][cx][0] = c;
+			shadow[cy][cx][1] = GRAY_ON_BLACK;
+			mark_dirty (cy);
 			if (++cx >= COL_CNT)
 				newline ();
 			break;
 	}
+}
 
-	/* Update cursor position. */
-	move_cursor ();
+/* Notes that row Y of the shadow screen has changed. */
+static void
+mark_dirty (size_t y) {
+	if (y < dirty_lo)
+		dirty_lo = y;
+	if (y + 1 > dirty_hi)
+		dirty_hi = y + 1;
+}
 
-	intr_set_level (old_level);
+/* Copies the rows of the shadow screen that changed to the
+   framebuffer and moves the hardware cursor to (cx,cy). */
+static void
+flush (void) {
+	if (dirty_lo < dirty_hi)
+		memcpy (&fb[dirty_lo], &shadow[dirty_lo],
+				sizeof fb[0] * (dirty_hi - dirty_lo));
+	dirty_lo = ROW_CNT;
+	dirty_hi = 0;
+	move_cursor ();
 }
-
+
 /* Clears the screen and moves the cursor to the upper left. */
 static void
 cls (void) {
@@ -100,7 +152,6 @@ cls (void) {
 		clear_row (y);
 
 	cx = cy = 0;
-	move_cursor ();
 }
 
 /* Clears row Y to spaces. */
@@ -110,9 +161,10 @@ clear_row (size_t y) {
 
 	for (x = 0; x < COL_CNT; x++)
 	{
-		fb[y][x][0] = ' ';
-		fb[y][x][1] = GRAY_ON_BLACK;
+		shadow[y][x][0] = ' ';
+		shadow[y][x][1] = GRAY_ON_BLACK;
 	}
+	mark_dirty (y);
 }
 
 /* Advances the cursor to the first column in the next line on
@@ -125,8 +177,9 @@ newline (void) {
 	if (cy >= ROW_CNT)
 	{
 		cy = ROW_CNT - 1;
-		memmove (&fb[0], &fb[1], sizeof fb[0] * (ROW_CNT - 1));
+		memmove (&shadow[0], &shadow[1], sizeof shadow[0] * (ROW_CNT - 1));
 		clear_row (ROW_CNT - 1);
+		mark_dirty (0);
 	}
 }
 
@@ -33,9 +33,13 @@ struct inode {
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	void *aux;                          /* See inode_set_aux(). */
+	void (*aux_destroy) (void *aux);    /* Frees AUX. */
 	struct inode_disk data;             /* Inode content. */
 };
 
+static void inode_drop_aux (struct inode *);
+
 /* Returns the disk sector that contains byte offset POS within
  * INODE.
  * Returns -1 if INODE does not contain data for a byte at offset
@@ -125,6 +129,8 @@ inode_open (disk_sector_t sector) {
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
+	inode->aux = NULL;
+	inode->aux_destroy = NULL;
 	disk_read (filesys_disk, inode->sector, &inode->data);
 	return inode;
 }
@@ -156,6 +162,7 @@ inode_close (struct inode *inode) {
 	if (--inode->open_cnt == 0) {
 		/* Remove from inode list and release lock. */
 		list_remove (&inode->elem);
+		inode_drop_aux (inode);
 
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
@@ -284,6 +291,9 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 	}
 	free (bounce);
 
+	/* Whatever was derived from the old contents is stale now. */
+	if (bytes_written > 0)
+		inode_drop_aux (inode);
 	return bytes_written;
 }
 
@@ -311,3 +321,30 @@ off_t
 inode_length (const struct inode *inode) {
 	return inode->data.length;
 }
+
+/* Attaches AUX, data derived from INODE's contents, to INODE, in
+ * place of whatever was attached before.  DESTROY is called to free
+ * AUX when INODE is written to or closed by its last opener, and also
+ * identifies AUX to inode_get_aux(). */
+void
+inode_set_aux (struct inode *inode, void *aux, void (*destroy) (void *)) {
+	inode_drop_aux (inode);
+	inode->aux = aux;
+	inode->aux_destroy = destroy;
+}
+
+/* Returns the data attached to INODE with inode_set_aux() along with
+ * DESTROY, or a null pointer if there is none. */
+void *
+inode_get_aux (const struct inode *inode, void (*destroy) (void *)) {
+	return inode->aux_destroy == destroy ? inode->aux : NULL;
+}
+
+/* Frees the data attached to INODE, if any. */
+static void
+inode_drop_aux (struct inode *inode) {
+	if (inode->aux_destroy != NULL)
+		inode->aux_destroy (inode->aux);
+	inode->aux = NULL;
+	inode->aux_destroy = NULL;
+}
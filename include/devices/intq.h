@@ -1,41 +1,52 @@
 #ifndef DEVICES_INTQ_H
 #define DEVICES_INTQ_H
 
+#include <list.h>
+#include <stddef.h>
 #include "threads/interrupt.h"
-#include "threads/synch.h"
 
 /* An "interrupt queue", a circular buffer shared between
    kernel threads and external interrupt handlers.
 
-   Interrupt queue functions can be called from kernel threads or
-   from external interrupt handlers.  Except for intq_init(),
-   interrupts must be off in either case.
-
-   The interrupt queue has the structure of a "monitor".  Locks
-   and condition variables from threads/synch.h cannot be used in
-   this case, as they normally would, because they can only
-   protect kernel threads from one another, not from interrupt
-   handlers. */
-
-/* Queue buffer size, in bytes. */
-#define INTQ_BUFSIZE 64
+   The queue has a single producer and a single consumer: one
+   side only ever advances HEAD and the other only ever advances
+   TAIL, each publishing its index only after it is done with the
+   bytes it covers.  So one thread or interrupt handler may add
+   bytes while another takes them out, with interrupts on or
+   off.  When more than one thread may be on the same side, the
+   caller must make them take turns, say by turning interrupts
+   off.
+
+   Any number of threads may sleep until there are bytes to take
+   or room to add them; each side wakes all of the other side's
+   sleepers when it makes progress.  Sleeping and waking are the
+   only operations that need interrupts off.  Locks and
+   condition variables from threads/synch.h cannot be used here,
+   as they normally would, because they can only protect kernel
+   threads from one another, not from interrupt handlers. */
 
 /* A circular queue of bytes. */
 struct intq {
+	uint8_t *buf;               /* Buffer. */
+	size_t size;                /* Size of BUF, a power of two. */
+	size_t head;                /* Bytes ever added, by the producer. */
+	size_t tail;                /* Bytes ever taken, by the consumer. */
+
 	/* Waiting threads. */
-	struct lock lock;           /* Only one thread may wait at once. */
-	struct thread *not_full;    /* Thread waiting for not-full condition. */
-	struct thread *not_empty;   /* Thread waiting for not-empty condition. */
-
-	/* Queue. */
-	uint8_t buf[INTQ_BUFSIZE];  /* Buffer. */
-	int head;                   /* New data is written here. */
-	int tail;                   /* Old data is read here. */
+	struct list not_full;       /* Threads waiting for room. */
+	struct list not_empty;      /* Threads waiting for bytes. */
 };
 
-void intq_init (struct intq *);
+void intq_init (struct intq *, void *buf, size_t size);
 bool intq_empty (const struct intq *);
 bool intq_full (const struct intq *);
+size_t intq_count (const struct intq *);
+
+size_t intq_put (struct intq *, const void *, size_t);
+size_t intq_get (struct intq *, void *, size_t);
+void intq_wait_not_full (struct intq *);
+void intq_wait_not_empty (struct intq *);
+
 uint8_t intq_getc (struct intq *);
 void intq_putc (struct intq *, uint8_t);
 
@@ -2,7 +2,9 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include "threads/interrupt.h"
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
@@ -12,12 +14,19 @@ void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_now_ns (void);
+uint64_t timer_tsc_hz (void);
 
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
+bool timer_start_sampler (int hz, intr_handler_func *);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
@@ -19,5 +19,7 @@ off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+void inode_set_aux (struct inode *, void *aux, void (*destroy) (void *));
+void *inode_get_aux (const struct inode *, void (*destroy) (void *));
 
 #endif /* filesys/inode.h */
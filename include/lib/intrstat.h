@@ -0,0 +1,21 @@
+#ifndef __LIB_INTRSTAT_H
+#define __LIB_INTRSTAT_H
+
+#include <stdint.h>
+
+/* Accounting for one interrupt vector, as reported by intrstat(). */
+struct intrstat {
+	int64_t count;              /* Times taken since boot. */
+	uint64_t cycles;            /* TSC cycles spent handling them. */
+	uint64_t max_cycles;        /* Longest one. */
+	uint64_t max_site;          /* For INTRSTAT_OFF, see below. */
+};
+
+/* Passed to intrstat() in place of a vector, asks for how long the
+   kernel kept interrupts turned off instead.  COUNT is the number
+   of times it turned them off and back on, CYCLES the total time
+   they were off, MAX_CYCLES the longest such span and MAX_SITE the
+   kernel address that started it. */
+#define INTRSTAT_OFF (-1)
+
+#endif /* lib/intrstat.h */
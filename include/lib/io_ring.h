@@ -0,0 +1,61 @@
+#ifndef __LIB_IO_RING_H
+#define __LIB_IO_RING_H
+
+#include <stdint.h>
+
+/* Submission and completion rings shared between a user process and
+   the kernel.
+
+   io_setup() maps one page holding a struct io_ring into the
+   process.  To issue requests, the process fills in sq[sq_tail %
+   IO_RING_ENTRIES] and increments sq_tail for each one, then calls
+   io_enter(), which carries out up to the given number of queued
+   requests in order in a single system call.  For each request the
+   kernel advances sq_head and posts a completion at cq[cq_tail %
+   IO_RING_ENTRIES], then increments cq_tail.  The process consumes
+   completions by advancing cq_head.  The kernel stops early when the
+   completion ring is full.
+
+   Head and tail indexes count up freely and are only reduced modulo
+   IO_RING_ENTRIES to index the arrays. */
+
+/* Entries in each ring.  A power of 2. */
+#define IO_RING_ENTRIES 64
+
+/* Request opcodes. */
+enum io_op {
+	IO_OP_NOP,                  /* Does nothing, result 0. */
+	IO_OP_READ,                 /* read (fd, addr, len). */
+	IO_OP_WRITE,                /* write (fd, addr, len). */
+	IO_OP_SEEK,                 /* seek (fd, off), result 0. */
+	IO_OP_OPEN,                 /* open (addr), result the fd. */
+	IO_OP_CLOSE,                /* close (fd), result 0. */
+};
+
+/* A submission queue entry. */
+struct io_sqe {
+	uint32_t opcode;            /* enum io_op. */
+	int32_t fd;                 /* File descriptor. */
+	uint64_t addr;              /* Buffer, or file name for IO_OP_OPEN. */
+	uint32_t len;               /* Buffer size. */
+	uint32_t off;               /* Position for IO_OP_SEEK. */
+	uint64_t user_data;         /* Copied to the completion as is. */
+};
+
+/* A completion queue entry. */
+struct io_cqe {
+	uint64_t user_data;         /* From the request. */
+	int64_t res;                /* What the matching system call returns. */
+};
+
+/* The shared page. */
+struct io_ring {
+	uint32_t sq_head;           /* Next request to run.  Kernel-owned. */
+	uint32_t sq_tail;           /* Next free request.  User-owned. */
+	uint32_t cq_head;           /* Next completion to read.  User-owned. */
+	uint32_t cq_tail;           /* Next free completion.  Kernel-owned. */
+	struct io_sqe sq[IO_RING_ENTRIES];
+	struct io_cqe cq[IO_RING_ENTRIES];
+};
+
+#endif /* lib/io_ring.h */
@@ -0,0 +1,170 @@
+#ifndef __LIB_KERNEL_RHASH_H
+#define __LIB_KERNEL_RHASH_H
+
+/* Open-addressed hash table.
+ *
+ * An alternative to the chained table in hash.h for tables that
+ * are looked up often: supplemental page tables, open-inode
+ * lists, caches.  Elements are found through a single array of
+ * slots instead of through lists of buckets.  Each slot holds a
+ * pointer to an element and that element's 64-bit hash value, its
+ * fingerprint, so a probe that meets a different element usually
+ * rejects it on the fingerprint alone, without touching the
+ * element or calling back into the caller.
+ *
+ * Collisions are resolved by linear probing with Robin Hood
+ * insertion: an element being inserted takes the slot of any
+ * element that is closer to its home slot than the newcomer
+ * already is, and the displaced element moves on instead.  That
+ * keeps probe sequences short and lets a lookup stop as soon as
+ * it meets an element closer to home than the one sought would
+ * be.  Deletion shifts the elements that follow back a slot
+ * instead of leaving a tombstone behind.
+ *
+ * The table grows when it is 7/8 full and shrinks when it is 1/8
+ * full, but not all at once: the old array stays alongside the new
+ * one, and each insertion or deletion moves a few more of its
+ * elements across, so no single operation pays for rehashing the
+ * whole table.  Lookups check both arrays meanwhile.
+ *
+ * Like struct hash, the table does not allocate its elements.
+ * Each structure that can be in one embeds a struct rhash_elem,
+ * and rhash_entry() converts back from it.  An element is in at
+ * most one rhash at a time through any given rhash_elem.
+ *
+ * A table made with rhash_init_keyed() has no hash or comparison
+ * functions at all.  Instead, each element is identified by an
+ * integer or pointer key stored in its rhash_elem, which the table
+ * hashes itself and compares directly in the slot.  RHASH_KEYED
+ * below declares typed wrappers for such a table. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Hash table element. */
+struct rhash_elem {
+	uint64_t key;               /* Hash value, or key if keyed. */
+};
+
+/* Converts pointer to hash element RHASH_ELEM into a pointer to
+ * the structure that RHASH_ELEM is embedded inside.  Supply the
+ * name of the outer structure STRUCT and the member name MEMBER
+ * of the hash element. */
+#define rhash_entry(RHASH_ELEM, STRUCT, MEMBER)                 \
+	((STRUCT *) ((uint8_t *) (RHASH_ELEM)                   \
+		- offsetof (STRUCT, MEMBER)))
+
+/* Computes and returns the hash value for hash element E, given
+ * auxiliary data AUX. */
+typedef uint64_t rhash_hash_func (const struct rhash_elem *e, void *aux);
+
+/* Returns true if hash elements A and B are equal, given
+ * auxiliary data AUX. */
+typedef bool rhash_equal_func (const struct rhash_elem *a,
+		const struct rhash_elem *b, void *aux);
+
+/* Performs some operation on hash element E, given auxiliary
+ * data AUX. */
+typedef void rhash_action_func (struct rhash_elem *e, void *aux);
+
+/* A slot in the table. */
+struct rhash_slot {
+	uint64_t key;               /* ELEM's key member. */
+	struct rhash_elem *elem;    /* Element, or null if empty. */
+};
+
+/* An array of slots. */
+struct rhash_array {
+	struct rhash_slot *slots;   /* Array of `cnt' slots. */
+	size_t cnt;                 /* Number of slots, a power of 2. */
+	int shift;                  /* 64 - log2(cnt). */
+};
+
+/* Hash table. */
+struct rhash {
+	size_t elem_cnt;            /* Number of elements in table. */
+	struct rhash_array cur;     /* Where new elements go. */
+	struct rhash_array old;     /* Being emptied into CUR, if slots != NULL. */
+	size_t old_idx;             /* First slot of OLD not yet emptied. */
+	rhash_hash_func *hash;      /* Hash function, or null if keyed. */
+	rhash_equal_func *equal;    /* Comparison function, or null if keyed. */
+	void *aux;                  /* Auxiliary data for `hash' and `equal'. */
+};
+
+/* A hash table iterator. */
+struct rhash_iterator {
+	struct rhash *hash;         /* The hash table. */
+	size_t idx;                 /* Slot index, counting CUR then OLD. */
+	struct rhash_elem *elem;    /* Current hash element. */
+};
+
+/* Basic life cycle. */
+bool rhash_init (struct rhash *, rhash_hash_func *, rhash_equal_func *,
+		void *aux);
+bool rhash_init_keyed (struct rhash *);
+void rhash_clear (struct rhash *, rhash_action_func *);
+void rhash_destroy (struct rhash *, rhash_action_func *);
+
+/* Search, insertion, deletion. */
+struct rhash_elem *rhash_insert (struct rhash *, struct rhash_elem *);
+struct rhash_elem *rhash_replace (struct rhash *, struct rhash_elem *);
+struct rhash_elem *rhash_find (struct rhash *, const struct rhash_elem *);
+struct rhash_elem *rhash_delete (struct rhash *, const struct rhash_elem *);
+void rhash_remove (struct rhash *, struct rhash_elem *);
+
+/* Keyed tables only. */
+struct rhash_elem *rhash_find_key (struct rhash *, uint64_t key);
+struct rhash_elem *rhash_delete_key (struct rhash *, uint64_t key);
+
+/* Iteration. */
+void rhash_apply (struct rhash *, rhash_action_func *);
+void rhash_first (struct rhash_iterator *, struct rhash *);
+struct rhash_elem *rhash_next (struct rhash_iterator *);
+struct rhash_elem *rhash_cur (struct rhash_iterator *);
+
+/* Information. */
+size_t rhash_size (struct rhash *);
+bool rhash_empty (struct rhash *);
+
+/* Declares inline functions for a keyed table of STRUCTs, each
+ * embedding a struct rhash_elem named MEMBER and identified by a
+ * key of integer or pointer type KEY:
+ *
+ *   STRUCT *NAME_insert (struct rhash *, STRUCT *, KEY);
+ *   STRUCT *NAME_find (struct rhash *, KEY);
+ *   STRUCT *NAME_delete (struct rhash *, KEY);
+ *   KEY NAME_key (const STRUCT *);
+ *
+ * which behave like rhash_insert(), rhash_find_key() and
+ * rhash_delete_key() but take and return STRUCTs and KEYs.  For
+ * example:
+ *
+ *   struct page { struct rhash_elem elem; ... };
+ *   RHASH_KEYED (spt, struct page, elem, void *)
+ *
+ *   struct page *p = spt_find (&spt, pg_round_down (va)); */
+#define RHASH_KEYED(NAME, STRUCT, MEMBER, KEY)                          \
+static inline STRUCT *                                                  \
+NAME##_insert (struct rhash *h, STRUCT *s, KEY key) {                   \
+	struct rhash_elem *e;                                           \
+	s->MEMBER.key = (uint64_t) (uintptr_t) key;                     \
+	e = rhash_insert (h, &s->MEMBER);                               \
+	return e != NULL ? rhash_entry (e, STRUCT, MEMBER) : NULL;      \
+}                                                                       \
+static inline STRUCT *                                                  \
+NAME##_find (struct rhash *h, KEY key) {                                \
+	struct rhash_elem *e = rhash_find_key (h, (uintptr_t) key);     \
+	return e != NULL ? rhash_entry (e, STRUCT, MEMBER) : NULL;      \
+}                                                                       \
+static inline STRUCT *                                                  \
+NAME##_delete (struct rhash *h, KEY key) {                              \
+	struct rhash_elem *e = rhash_delete_key (h, (uintptr_t) key);   \
+	return e != NULL ? rhash_entry (e, STRUCT, MEMBER) : NULL;      \
+}                                                                       \
+static inline KEY                                                       \
+NAME##_key (const STRUCT *s) {                                          \
+	return (KEY) (uintptr_t) s->MEMBER.key;                         \
+}
+
+#endif /* lib/kernel/rhash.h */
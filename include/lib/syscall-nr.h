@@ -36,6 +36,21 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extensions. */
+	SYS_READV,                  /* Read from a file into several buffers. */
+	SYS_WRITEV,                 /* Write several buffers to a file. */
+	SYS_PREAD,                  /* Read from a file at a given position. */
+	SYS_PWRITE,                 /* Write to a file at a given position. */
+	SYS_IO_SETUP,               /* Map the submission/completion rings. */
+	SYS_IO_ENTER,               /* Run requests queued on the rings. */
+	SYS_SYSSTAT,                /* Report a system call's accounting. */
+	SYS_PIPE,                   /* Create a pipe. */
+	SYS_SPAWN,                  /* Start a new process running a file. */
+	SYS_VFORK,                  /* Fork, borrowing the address space. */
+	SYS_WAIT_ANY,               /* Wait for whichever child exits first. */
+	SYS_CLOCK_GETTIME,          /* Read a clock. */
+	SYS_INTRSTAT,               /* Report an interrupt's accounting. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,12 @@
+#ifndef __LIB_SYSSTAT_H
+#define __LIB_SYSSTAT_H
+
+#include <stdint.h>
+
+/* Accounting for one system call, as reported by sysstat(). */
+struct sysstat {
+	int64_t calls;              /* Times invoked since boot. */
+	uint64_t cycles;            /* TSC cycles spent handling them. */
+};
+
+#endif /* lib/sysstat.h */
@@ -0,0 +1,19 @@
+#ifndef __LIB_TIME_H
+#define __LIB_TIME_H
+
+#include <stdint.h>
+
+/* A clock, as named to clock_gettime(). */
+typedef int clockid_t;
+
+/* Time since boot.  The only clock there is, since nothing keeps the
+   time of day. */
+#define CLOCK_MONOTONIC 1
+
+/* A point in time, as reported by clock_gettime(). */
+struct timespec {
+	int64_t tv_sec;             /* Seconds. */
+	int64_t tv_nsec;            /* Nanoseconds, 0 to 999,999,999. */
+};
+
+#endif /* lib/time.h */
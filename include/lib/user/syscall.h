@@ -4,6 +4,11 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <intrstat.h>
+#include <iovec.h>
+#include <io_ring.h>
+#include <sysstat.h>
+#include <time.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -25,7 +30,20 @@ void halt (void) NO_RETURN;
 void exit (int status) NO_RETURN;
 pid_t fork (const char *thread_name);
 int exec (const char *file);
+
+/* Process creation without copying the address space.  spawn()
+   starts FILE with the null-terminated ARGV in a new process.  The
+   child of vfork() runs in its parent's address space, with the
+   parent suspended, until it calls exec() or exit(); it must not
+   return from the function that called vfork(). */
+pid_t spawn (const char *file, char *const argv[]);
+pid_t vfork (const char *thread_name) __attribute__ ((returns_twice));
 int wait (pid_t);
+
+/* Waits for whichever child exits first, stores its exit status in
+   *STATUS unless STATUS is null, and returns its pid.  Returns -1 if
+   there are no children to wait for. */
+pid_t wait_any (int *status);
 bool create (const char *file, unsigned initial_size);
 bool remove (const char *file);
 int open (const char *file);
@@ -38,10 +56,32 @@ void close (int fd);
 
 int dup2(int oldfd, int newfd);
 
+/* Pipe with its read end in FDS[0] and write end in FDS[1]. */
+int pipe (int fds[2]);
+
+/* Batched and positioned I/O. */
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int pread (int fd, void *buffer, unsigned length, off_t offset);
+int pwrite (int fd, const void *buffer, unsigned length, off_t offset);
+
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
 
+/* Accounting of system call NR. */
+int sysstat (int nr, struct sysstat *);
+
+/* Current time of CLOCK, see time.h. */
+int clock_gettime (clockid_t clock, struct timespec *);
+
+/* Accounting of interrupt VEC, or INTRSTAT_OFF, see intrstat.h. */
+int intrstat (int vec, struct intrstat *);
+
+/* Requests queued on shared rings, see io_ring.h. */
+struct io_ring *io_setup (void);
+int io_enter (unsigned to_submit);
+
 /* Project 4 only. */
 bool chdir (const char *dir);
 bool mkdir (const char *dir);
@@ -1,6 +1,7 @@
 #ifndef THREADS_INTERRUPT_H
 #define THREADS_INTERRUPT_H
 
+#include <intrstat.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -72,7 +73,14 @@ void intr_register_int (uint8_t vec, int dpl, enum intr_level,
 bool intr_context (void);
 void intr_yield_on_return (void);
 
+/* Local APIC.  Its interrupts use vectors 0x30...0x3f. */
+bool lapic_present (void);
+uint32_t lapic_read (unsigned reg);
+void lapic_write (unsigned reg, uint32_t value);
+
 void intr_dump_frame (const struct intr_frame *);
+bool intr_get_stats (int vec, struct intrstat *);
+void intr_print_stats (void);
 const char *intr_name (uint8_t vec);
 
 #endif /* threads/interrupt.h */
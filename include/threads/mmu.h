@@ -5,13 +5,24 @@
 #include <stdint.h>
 #include "threads/pte.h"
 
+/* PCID tag of a user address space, see pml4_activate_tagged().
+ * A zeroed tag is valid and simply not assigned yet. */
+struct pcid_tag {
+	uint16_t pcid;                      /* Assigned PCID. */
+	uint64_t gen;                       /* Generation it belongs to. */
+};
+
 typedef bool pte_for_each_func (uint64_t *pte, void *va, void *aux);
 
 uint64_t *pml4e_walk (uint64_t *pml4, const uint64_t va, int create);
+uint64_t *pml4e_walk_pde (uint64_t *pml4, const uint64_t va, int create);
 uint64_t *pml4_create (void);
 bool pml4_for_each (uint64_t *, pte_for_each_func *, void *);
 void pml4_destroy (uint64_t *pml4);
 void pml4_activate (uint64_t *pml4);
+void pml4_activate_tagged (uint64_t *pml4, struct pcid_tag *);
+void pcid_init (void);
+void pcid_print_stats (void);
 void *pml4_get_page (uint64_t *pml4, const void *upage);
 bool pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw);
 void pml4_clear_page (uint64_t *pml4, void *upage);
@@ -23,6 +34,7 @@ void pml4_set_accessed (uint64_t *pml4, const void *upage, bool accessed);
 #define is_writable(pte) (*(pte) & PTE_W)
 #define is_user_pte(pte) (*(pte) & PTE_U)
 #define is_kern_pte(pte) (!is_user_pte (pte))
+#define is_huge_pte(pte) (*(pte) & PTE_PS)
 
 #define pte_get_paddr(pte) (pg_round_down(*(pte)))
 
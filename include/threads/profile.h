@@ -0,0 +1,10 @@
+#ifndef THREADS_PROFILE_H
+#define THREADS_PROFILE_H
+
+struct intr_frame;
+
+void profile_init (int hz);
+void profile_tick (const struct intr_frame *, int tick_cnt);
+void profile_print (void);
+
+#endif /* threads/profile.h */
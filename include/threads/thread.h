@@ -6,7 +6,7 @@
 #include <stdint.h>
 #include "threads/interrupt.h"
 #include "threads/synch.h"
-#define FDT_PAGES DIV_ROUND_UP(FDCOUNT_LIMIT, 512)
+#include "threads/mmu.h"
 #ifdef VM
 #include "vm/vm.h"
 #endif
@@ -97,16 +97,28 @@ struct thread {
 
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem;              /* List element. */
-	int64_t wakeup_tick;
+	int64_t wakeup_time;                /* When to wake up, in ns since boot. */
+
+	/* Owned by threads/fpu.c. */
+	void *fpu_buf;                      /* Holds FPU save area, or null. */
 
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
 	uint64_t *pml4;                     /* Page map level 4 */
+	struct pcid_tag pcid;               /* TLB tag of pml4. */
 	// exit_status 추가
 	int exit_status; 
-	struct file **fdt;  // 파일 디스크립터 테이블
-	int fdidx;  // 파일 디스크립터 인덱스
+	struct fd_table *fdt;  // 파일 디스크립터 테이블 (fork한 프로세스끼리 공유될 수 있음)
 	struct file *running;             /* 🔥 현재 실행 중인 실행 파일 */
+	uint64_t user_rsp;                  /* User rsp on syscall entry. */
+	struct vfork_info *vfork;           /* Parent lending us its address space. */
+
+	/* Owned by userprog/child.c. */
+	struct hash *children;              /* Exit status of each child, by tid. */
+	struct list exited_children;        /* Children exited but not waited for. */
+	struct semaphore child_exited;      /* Wakes us waiting for a child. */
+	bool waiting_child;                 /* Asleep on CHILD_EXITED? */
+	struct child_status *exit_record;   /* Our exit status, for our parent. */
 #endif
 #ifdef VM
 	/* Table for whole virtual memory owned by thread. */
@@ -116,13 +128,6 @@ struct thread {
 	/* Owned by thread.c. */
 	struct intr_frame tf;               /* Information for switching */
 	unsigned magic;                     /* Detects stack overflow. */
-	struct intr_frame parent_if;
-	struct list child_list; 
-	struct list_elem child_elem;
-
-	struct semaphore load_sema;
-	struct semaphore exit_sema; 
-	struct semaphore wait_sema;
 };
 
 /* If false (default), use round-robin scheduler.
@@ -151,6 +156,7 @@ void thread_yield (void);
 
 void thread_sleep(int64_t);
 void check_sleep_list(int64_t);
+int64_t thread_next_wakeup(void);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
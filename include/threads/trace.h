@@ -0,0 +1,52 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Kernel event tracing.  See trace.c. */
+
+/* Events.  utils/trace2json knows these by number, so add new
+   ones at the end. */
+enum trace_event {
+	TRACE_SCHEDULE,             /* Switch away: next tid, old status. */
+	TRACE_BLOCK,                /* Thread blocks. */
+	TRACE_UNBLOCK,              /* Thread unblocked: its tid. */
+	TRACE_INTR_ENTER,           /* Interrupt: vector, rip. */
+	TRACE_INTR_EXIT,            /* Interrupt done: vector. */
+	TRACE_DISK_READ,            /* Disk read starts: sector, disk. */
+	TRACE_DISK_WRITE,           /* Disk write starts: sector, disk. */
+	TRACE_DISK_DONE,            /* Disk transfer done: sector, disk. */
+	TRACE_FAULT,                /* Page fault: address, write. */
+	TRACE_FAULT_DONE,           /* Page fault handled: success. */
+	TRACE_SYSCALL,              /* System call: number, first arg. */
+	TRACE_SYSCALL_DONE,         /* System call returns: number, result. */
+	TRACE_THREAD_NAME,          /* Thread created: name, in two parts. */
+};
+
+/* A trace record, as kept in memory and written to disk. */
+struct trace_record {
+	uint64_t tsc;               /* Time stamp counter. */
+	uint32_t event;             /* An enum trace_event. */
+	int32_t tid;                /* Thread the event happened on. */
+	uint64_t arg0;              /* Event-specific arguments. */
+	uint64_t arg1;
+};
+
+/* -trace: Record events? */
+extern bool trace_enabled;
+
+/* Records EVENT with arguments A0 and A1 if tracing is on.
+   Cheap enough to leave in hot paths when it is off. */
+#define TRACE(EVENT, A0, A1)                                        \
+	do {                                                            \
+		if (trace_enabled)                                          \
+			trace_record (EVENT, (uint64_t) (A0), (uint64_t) (A1)); \
+	} while (0)
+
+void trace_init (void);
+void trace_record (enum trace_event, uint64_t arg0, uint64_t arg1);
+void trace_thread_name (int tid, const char *name);
+void trace_dump (void);
+
+#endif /* threads/trace.h */
@@ -0,0 +1,17 @@
+#ifndef USERPROG_CHILD_H
+#define USERPROG_CHILD_H
+
+#include <stdbool.h>
+#include "threads/thread.h"
+
+/* Exit status of a child process.  See child.c. */
+struct child_status;
+
+bool child_register (struct thread *child);
+void child_exit (int status);
+void child_release_all (void);
+
+int child_wait (tid_t tid);
+tid_t child_wait_any (int *status);
+
+#endif /* userprog/child.h */
@@ -0,0 +1,43 @@
+#ifndef USERPROG_FDTABLE_H
+#define USERPROG_FDTABLE_H
+
+#include <stdbool.h>
+
+struct file;
+struct pipe;
+
+/* A process's file descriptor table.  See fdtable.c. */
+struct fd_table;
+
+/* What an open file description refers to. */
+enum fd_type {
+	FD_STDIN,                   /* Keyboard. */
+	FD_STDOUT,                  /* Console. */
+	FD_FILE,                    /* File in the file system. */
+	FD_PIPE_READ,               /* Read end of a pipe. */
+	FD_PIPE_WRITE               /* Write end of a pipe. */
+};
+
+/* An open file description.  Descriptors made from one another with
+ * dup2() refer to the same description, and so share the position. */
+struct open_file {
+	enum fd_type type;          /* What it refers to. */
+	int ref_cnt;                /* Descriptors referring to it. */
+	struct file *file;          /* The file, for FD_FILE. */
+	struct pipe *pipe;          /* The pipe, for the pipe ends. */
+	struct open_file *copy;     /* Its copy while its table is copied. */
+};
+
+/* Most descriptors a process can have open at once. */
+#define FD_MAX 8192
+
+struct fd_table *fd_table_create (void);
+struct fd_table *fd_table_share (struct fd_table *);
+void fd_table_release (struct fd_table *);
+
+int fd_table_install (struct fd_table **, enum fd_type, void *object);
+struct open_file *fd_table_get (struct fd_table **, int fd);
+bool fd_table_close (struct fd_table **, int fd);
+int fd_table_dup2 (struct fd_table **, int oldfd, int newfd);
+
+#endif /* userprog/fdtable.h */
@@ -0,0 +1,17 @@
+#ifndef USERPROG_PIPE_H
+#define USERPROG_PIPE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A pipe between processes.  See pipe.c. */
+struct pipe;
+
+struct pipe *pipe_create (void);
+void pipe_dup (struct pipe *, bool writer);
+void pipe_close (struct pipe *, bool writer);
+
+int pipe_read (struct pipe *, void *ubuf, size_t size, bool *fault);
+int pipe_write (struct pipe *, const void *ubuf, size_t size, bool *fault);
+
+#endif /* userprog/pipe.h */
@@ -5,11 +5,12 @@
 
 tid_t process_create_initd (const char *file_name);
 tid_t process_fork (const char *name, struct intr_frame *if_);
+tid_t process_spawn (const char *file, const char *args, size_t len);
+tid_t process_vfork (const char *name, struct intr_frame *if_);
 int process_exec (void *f_name);
 int process_wait (tid_t);
+tid_t process_wait_any (int *status);
 void process_exit (void);
 void process_activate (struct thread *next);
-void argument_stack(char **parse, int count, void **rsp);
-struct thread *get_child_process(int pid);
 
 #endif /* userprog/process.h */
@@ -1,12 +1,13 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 #include <stdbool.h>
+#include <stddef.h>
 #include "filesys/file.h"
 
 void syscall_init (void);
+void syscall_print_stats (void);
 
 #endif /* userprog/syscall.h */
-void check_address(void *addr);
 void halt(void);
 void exit(int status);
 bool create(const char *file, unsigned initial_size);
@@ -19,6 +20,31 @@ int filesize(int fd);
 void seek(int fd, unsigned position);
 unsigned tell(int fd);
 void close(int fd);
+int dup2(int oldfd, int newfd);
+int pipe(int *fds);
+
+struct iovec;
+struct intrstat;
+struct sysstat;
+struct timespec;
+struct intr_frame;
+int exec(const char *file_name);
+int spawn(const char *file, char *const argv[]);
+int vfork(const char *thread_name, struct intr_frame *f);
+int wait_any(int *status);
+int sysstat(int nr, struct sysstat *st);
+int clock_gettime(int clock, struct timespec *ts);
+int intrstat(int vec, struct intrstat *st);
+int readv(int fd, const struct iovec *iov, int iovcnt);
+int writev(int fd, const struct iovec *iov, int iovcnt);
+int pread(int fd, void *buffer, unsigned size, off_t offset);
+int pwrite(int fd, const void *buffer, unsigned size, off_t offset);
+#ifdef VM
+void *mmap(void *addr, size_t length, int writable, int fd, off_t offset);
+void munmap(void *addr);
+struct io_ring *io_setup(void);
+int io_enter(unsigned to_submit);
+#endif
 
 int process_add_file(struct file *f);
 struct file *process_get_file(int fd);
\ No newline at end of file
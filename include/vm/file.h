@@ -5,12 +5,34 @@
 
 struct page;
 enum vm_type;
+struct file_cache_page;
 
+/* A page of an mmap'd file.  It maps the file's cached copy of the page,
+ * shared with every other mapping of the same page, rather than a frame
+ * of its own. */
 struct file_page {
+	struct file *file;          /* Backing file. */
+	off_t ofs;                  /* Offset of the page in FILE. */
+	uint32_t read_bytes;        /* Bytes read from FILE, rest is zeroed. */
+	size_t map_pages;           /* Pages of the mapping, if the first one. */
+	struct file_cache_page *cache;  /* Cached page mapped, if any. */
+	struct list_elem cache_elem;    /* Element in the cached page's mappers. */
+	uint64_t *pml4;             /* Page table CACHE is mapped in. */
+};
+
+/* AUX of a page that is lazily loaded from a file.  The page owns FILE, a
+ * reference obtained by file_reopen(), and closes it together with AUX. */
+struct lazy_load_aux {
+	struct file *file;          /* File to read from. */
+	off_t ofs;                  /* Offset to read from. */
+	uint32_t read_bytes;        /* Bytes to read, rest of the page is zeroed. */
+	size_t map_pages;           /* Pages of the mmap() starting here, else 0. */
 };
 
 void vm_file_init (void);
 bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
+bool file_backed_map (struct page *page);
+bool file_backed_fork (struct page *page);
 void *do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset);
 void do_munmap (void *va);
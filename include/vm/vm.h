@@ -1,6 +1,8 @@
 #ifndef VM_VM_H
 #define VM_VM_H
 #include <stdbool.h>
+#include <hash.h>
+#include <list.h>
 #include "threads/palloc.h"
 
 enum vm_type {
@@ -24,6 +26,17 @@ enum vm_type {
 	VM_MARKER_END = (1 << 31),
 };
 
+/* Marks an uninit page whose AUX is a struct lazy_load_aux, that is, one
+ * whose contents are read from a file on first touch.  Such pages are the
+ * candidates for fault-around. */
+#define VM_FILE_AUX VM_MARKER_0
+
+/* Marks a page of the user stack. */
+#define VM_STACK VM_MARKER_1
+
+/* Maximum size of a user stack, in pages.  1 MB by default. */
+extern size_t stack_page_limit;
+
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
@@ -46,6 +59,10 @@ struct page {
 	struct frame *frame;   /* Back reference for frame */
 
 	/* Your implementation */
+	struct hash_elem spt_elem;  /* Element in the supplemental page table. */
+	bool writable;              /* Mapped read/write? */
+	bool prefetched;            /* Mapped by fault-around, not by a fault. */
+	bool zero_mapped;           /* Mapped read-only to the shared zero page. */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -63,6 +80,7 @@ struct page {
 struct frame {
 	void *kva;
 	struct page *page;
+	struct list_elem frame_elem;  /* Element in the frame table. */
 };
 
 /* The function table for page operations.
@@ -85,6 +103,15 @@ struct page_operations {
  * We don't want to force you to obey any specific design for this struct.
  * All designs up to you for this. */
 struct supplemental_page_table {
+	struct hash pages;          /* Pages keyed by user virtual address. */
+
+	/* Fault-around stream detection. */
+	void *fa_next;              /* Where a sequential walk faults next. */
+	size_t fa_window;           /* Pages to map on the next fault. */
+
+	/* Stack growth. */
+	void *stack_bottom;         /* Lowest page of the stack. */
+	size_t stack_batch;         /* Pages to map past the next growth fault. */
 };
 
 #include "threads/thread.h"
@@ -98,6 +125,7 @@ bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
 
 void vm_init (void);
+void vm_print_stats (void);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		bool write, bool not_present);
 
@@ -107,6 +135,7 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
+void vm_free_frame (struct page *page);
 enum vm_type page_get_type (struct page *page);
 
 #endif  /* VM_VM_H */
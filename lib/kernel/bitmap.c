@@ -272,6 +272,22 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) {
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 
+	if (cnt == 1) {
+		/* Looking for a single bit: skip a whole element at a time
+		   past elements with no bit set to VALUE. */
+		elem_type mask = (elem_type) -1 << (start % ELEM_BITS);
+		size_t i;
+
+		for (i = elem_idx (start); i < elem_cnt (b->bit_cnt); i++) {
+			elem_type bits = (value ? b->bits[i] : ~b->bits[i]) & mask;
+			if (bits != 0) {
+				size_t idx = i * ELEM_BITS + __builtin_ctzl (bits);
+				return idx < b->bit_cnt ? idx : BITMAP_ERROR;
+			}
+			mask = (elem_type) -1;
+		}
+		return BITMAP_ERROR;
+	}
 	if (cnt <= b->bit_cnt) {
 		size_t last = b->bit_cnt - cnt;
 		size_t i;
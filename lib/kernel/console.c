@@ -1,6 +1,7 @@
 #include <console.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/serial.h"
 #include "devices/vga.h"
 #include "threads/init.h"
@@ -9,6 +10,7 @@
 
 static void vprintf_helper (char, void *);
 static void putchar_have_lock (uint8_t c);
+static void putbuf_have_lock (const char *, size_t);
 
 /* The console lock.
    Both the vga and serial layers do their own locking, so it's
@@ -59,6 +61,14 @@ static int console_lock_depth;
 /* Number of characters written to console. */
 static int64_t write_cnt;
 
+/* Output of a vprintf() call, gathered so that it reaches the
+   devices a batch at a time. */
+struct vprintf_buf {
+	int char_cnt;               /* Characters output so far. */
+	size_t len;                 /* Characters in BUF. */
+	char buf[128];
+};
+
 /* Enable console locking. */
 void
 console_init (void) {
@@ -116,13 +126,16 @@ console_locked_by_current_thread (void) {
    Writes its output to both vga display and serial port. */
 int
 vprintf (const char *format, va_list args) {
-	int char_cnt = 0;
+	struct vprintf_buf b;
 
+	b.char_cnt = 0;
+	b.len = 0;
 	acquire_console ();
-	__vprintf (format, args, vprintf_helper, &char_cnt);
+	__vprintf (format, args, vprintf_helper, &b);
+	putbuf_have_lock (b.buf, b.len);
 	release_console ();
 
-	return char_cnt;
+	return b.char_cnt;
 }
 
 /* Writes string S to the console, followed by a new-line
@@ -130,8 +143,7 @@ vprintf (const char *format, va_list args) {
 int
 puts (const char *s) {
 	acquire_console ();
-	while (*s != '\0')
-		putchar_have_lock (*s++);
+	putbuf_have_lock (s, strlen (s));
 	putchar_have_lock ('\n');
 	release_console ();
 
@@ -142,8 +154,7 @@ puts (const char *s) {
 void
 putbuf (const char *buffer, size_t n) {
 	acquire_console ();
-	while (n-- > 0)
-		putchar_have_lock (*buffer++);
+	putbuf_have_lock (buffer, n);
 	release_console ();
 }
 
@@ -159,10 +170,14 @@ putchar (int c) {
 
 /* Helper function for vprintf(). */
 static void
-vprintf_helper (char c, void *char_cnt_) {
-	int *char_cnt = char_cnt_;
-	(*char_cnt)++;
-	putchar_have_lock (c);
+vprintf_helper (char c, void *b_) {
+	struct vprintf_buf *b = b_;
+	b->char_cnt++;
+	b->buf[b->len++] = c;
+	if (b->len == sizeof b->buf) {
+		putbuf_have_lock (b->buf, b->len);
+		b->len = 0;
+	}
 }
 
 /* Writes C to the vga display and serial port.
@@ -175,3 +190,15 @@ putchar_have_lock (uint8_t c) {
 	serial_putc (c);
 	vga_putc (c);
 }
+
+/* Writes the N characters in BUFFER to the vga display and
+   serial port, each in a single batch.
+   The caller has already acquired the console lock if
+   appropriate. */
+static void
+putbuf_have_lock (const char *buffer, size_t n) {
+	ASSERT (console_locked_by_current_thread ());
+	write_cnt += n;
+	serial_putbuf (buffer, n);
+	vga_putbuf (buffer, n);
+}
@@ -0,0 +1,487 @@
+/* Open-addressed hash table.
+
+   See rhash.h for basic information. */
+
+#include "rhash.h"
+#include "../debug.h"
+#include <string.h>
+#include "threads/malloc.h"
+
+/* Size limits, in slots and elements per slot. */
+#define MIN_SLOTS 8             /* Never fewer slots than this. */
+#define GROW_LOAD(CNT) ((CNT) / 8 * 7)  /* More elems than this: grow. */
+#define SHRINK_LOAD(CNT) ((CNT) / 8)    /* Fewer elems than this: shrink. */
+
+/* Slots of the old array moved across per insertion or deletion
+   while resizing.  After growing from N slots to 2N, another 7N/8
+   insertions fill the new array to the point of growing again,
+   so anything over 8/7 empties the old array before then. */
+#define MIGRATE_SLOTS 8
+
+/* Marks a slot in the old array whose element has been moved to
+   the new array or deleted.  The slot keeps its key, so that
+   lookups still probe past it correctly. */
+static struct rhash_elem moved;
+#define MOVED (&moved)
+
+static bool init_array (struct rhash_array *, size_t cnt);
+static struct rhash_slot *find_slot (struct rhash *, uint64_t key,
+		const struct rhash_elem *);
+static void insert_elem (struct rhash *, struct rhash_elem *);
+static void place (struct rhash_array *, uint64_t key, struct rhash_elem *);
+static void remove_slot (struct rhash *, struct rhash_slot *);
+static void migrate (struct rhash *, size_t slot_cnt);
+static bool resize (struct rhash *, size_t cnt);
+static struct rhash_elem *live_elem (struct rhash_slot *);
+
+/* Initializes hash table H to compute hash values using HASH and
+   compare hash elements using EQUAL, given auxiliary data AUX. */
+bool
+rhash_init (struct rhash *h,
+		rhash_hash_func *hash, rhash_equal_func *equal, void *aux) {
+	h->elem_cnt = 0;
+	h->old.slots = NULL;
+	h->old.cnt = 0;
+	h->old_idx = 0;
+	h->hash = hash;
+	h->equal = equal;
+	h->aux = aux;
+	return init_array (&h->cur, MIN_SLOTS);
+}
+
+/* Initializes hash table H as a keyed table, whose elements are
+   identified by the KEY member of their rhash_elem. */
+bool
+rhash_init_keyed (struct rhash *h) {
+	return rhash_init (h, NULL, NULL, NULL);
+}
+
+/* Removes all the elements from H.
+
+   If DESTRUCTOR is non-null, then it is called for each element
+   in the hash.  DESTRUCTOR may, if appropriate, deallocate the
+   memory used by the hash element.  However, modifying hash
+   table H while rhash_clear() is running, using any of the
+   functions rhash_clear(), rhash_destroy(), rhash_insert(),
+   rhash_replace(), rhash_delete() or rhash_remove(), yields
+   undefined behavior, whether done in DESTRUCTOR or elsewhere. */
+void
+rhash_clear (struct rhash *h, rhash_action_func *destructor) {
+	if (destructor != NULL)
+		rhash_apply (h, destructor);
+
+	memset (h->cur.slots, 0, sizeof *h->cur.slots * h->cur.cnt);
+	free (h->old.slots);
+	h->old.slots = NULL;
+	h->old.cnt = 0;
+	h->elem_cnt = 0;
+}
+
+/* Destroys hash table H.
+
+   If DESTRUCTOR is non-null, then it is first called for each
+   element in the hash, as in rhash_clear(). */
+void
+rhash_destroy (struct rhash *h, rhash_action_func *destructor) {
+	if (destructor != NULL)
+		rhash_apply (h, destructor);
+	free (h->cur.slots);
+	free (h->old.slots);
+}
+
+/* Inserts NEW into hash table H and returns a null pointer, if
+   no equal element is already in the table.
+   If an equal element is already in the table, returns it
+   without inserting NEW.
+
+   In a keyed table, NEW's KEY member must already be set.
+
+   Panics if the table is full and there is no memory to grow
+   it. */
+struct rhash_elem *
+rhash_insert (struct rhash *h, struct rhash_elem *new) {
+	struct rhash_slot *old;
+
+	if (h->hash != NULL)
+		new->key = h->hash (new, h->aux);
+	old = find_slot (h, new->key, new);
+	if (old != NULL)
+		return old->elem;
+
+	insert_elem (h, new);
+	return NULL;
+}
+
+/* Inserts NEW into hash table H, replacing any equal element
+   already in the table, which is returned. */
+struct rhash_elem *
+rhash_replace (struct rhash *h, struct rhash_elem *new) {
+	struct rhash_slot *slot;
+	struct rhash_elem *old = NULL;
+
+	if (h->hash != NULL)
+		new->key = h->hash (new, h->aux);
+	slot = find_slot (h, new->key, new);
+	if (slot != NULL) {
+		old = slot->elem;
+		remove_slot (h, slot);
+	}
+	insert_elem (h, new);
+	return old;
+}
+
+/* Finds and returns an element equal to E in hash table H, or a
+   null pointer if no equal element exists in the table. */
+struct rhash_elem *
+rhash_find (struct rhash *h, const struct rhash_elem *e) {
+	uint64_t key = h->hash != NULL ? h->hash (e, h->aux) : e->key;
+	struct rhash_slot *slot = find_slot (h, key, e);
+
+	return slot != NULL ? slot->elem : NULL;
+}
+
+/* Finds, removes, and returns an element equal to E in hash
+   table H.  Returns a null pointer if no equal element existed
+   in the table.
+
+   If the elements of the hash table are dynamically allocated,
+   or own resources that are, then it is the caller's
+   responsibility to deallocate them. */
+struct rhash_elem *
+rhash_delete (struct rhash *h, const struct rhash_elem *e) {
+	uint64_t key = h->hash != NULL ? h->hash (e, h->aux) : e->key;
+	struct rhash_slot *slot = find_slot (h, key, e);
+	struct rhash_elem *found = NULL;
+
+	if (slot != NULL) {
+		found = slot->elem;
+		remove_slot (h, slot);
+	}
+	return found;
+}
+
+/* Removes E, which must be in hash table H, from H.  Unlike
+   rhash_delete(), this neither hashes nor compares E: it finds
+   E by the hash value stored in it when it was inserted. */
+void
+rhash_remove (struct rhash *h, struct rhash_elem *e) {
+	struct rhash_slot *slot = find_slot (h, e->key, e);
+
+	ASSERT (slot != NULL && slot->elem == e);
+	remove_slot (h, slot);
+}
+
+/* Finds and returns the element with KEY in keyed hash table H,
+   or a null pointer if there is none. */
+struct rhash_elem *
+rhash_find_key (struct rhash *h, uint64_t key) {
+	struct rhash_slot *slot;
+
+	ASSERT (h->hash == NULL);
+
+	slot = find_slot (h, key, NULL);
+	return slot != NULL ? slot->elem : NULL;
+}
+
+/* Finds, removes, and returns the element with KEY in keyed hash
+   table H.  Returns a null pointer if there was none. */
+struct rhash_elem *
+rhash_delete_key (struct rhash *h, uint64_t key) {
+	struct rhash_slot *slot;
+	struct rhash_elem *found = NULL;
+
+	ASSERT (h->hash == NULL);
+
+	slot = find_slot (h, key, NULL);
+	if (slot != NULL) {
+		found = slot->elem;
+		remove_slot (h, slot);
+	}
+	return found;
+}
+
+/* Calls ACTION for each element in hash table H in arbitrary
+   order.
+   Modifying hash table H while rhash_apply() is running, using
+   any of the functions rhash_clear(), rhash_destroy(),
+   rhash_insert(), rhash_replace(), rhash_delete() or
+   rhash_remove(), yields undefined behavior, whether done from
+   ACTION or elsewhere. */
+void
+rhash_apply (struct rhash *h, rhash_action_func *action) {
+	struct rhash_iterator i;
+
+	ASSERT (action != NULL);
+
+	rhash_first (&i, h);
+	while (rhash_next (&i))
+		action (rhash_cur (&i), h->aux);
+}
+
+/* Initializes I for iterating hash table H.
+
+   Iteration idiom:
+
+   struct rhash_iterator i;
+
+   rhash_first (&i, h);
+   while (rhash_next (&i))
+   {
+   struct foo *f = rhash_entry (rhash_cur (&i), struct foo, elem);
+   ...do something with f...
+   }
+
+   Modifying hash table H during iteration, using any of the
+   functions rhash_clear(), rhash_destroy(), rhash_insert(),
+   rhash_replace(), rhash_delete() or rhash_remove(),
+   invalidates all iterators. */
+void
+rhash_first (struct rhash_iterator *i, struct rhash *h) {
+	ASSERT (i != NULL);
+	ASSERT (h != NULL);
+
+	i->hash = h;
+	i->idx = 0;
+	i->elem = NULL;
+}
+
+/* Advances I to the next element in the hash table and returns
+   it.  Returns a null pointer if no elements are left.  Elements
+   are returned in arbitrary order. */
+struct rhash_elem *
+rhash_next (struct rhash_iterator *i) {
+	struct rhash *h;
+
+	ASSERT (i != NULL);
+
+	h = i->hash;
+	i->elem = NULL;
+	while (i->elem == NULL && i->idx < h->cur.cnt + h->old.cnt) {
+		if (i->idx < h->cur.cnt)
+			i->elem = live_elem (&h->cur.slots[i->idx]);
+		else
+			i->elem = live_elem (&h->old.slots[i->idx - h->cur.cnt]);
+		i->idx++;
+	}
+	return i->elem;
+}
+
+/* Returns the current element in the hash table iteration, or a
+   null pointer at the end of the table.  Undefined behavior
+   after calling rhash_first() but before rhash_next(). */
+struct rhash_elem *
+rhash_cur (struct rhash_iterator *i) {
+	return i->elem;
+}
+
+/* Returns the number of elements in H. */
+size_t
+rhash_size (struct rhash *h) {
+	return h->elem_cnt;
+}
+
+/* Returns true if H contains no elements, false otherwise. */
+bool
+rhash_empty (struct rhash *h) {
+	return h->elem_cnt == 0;
+}
+
+/* Returns the element in SLOT, or a null pointer if it is empty
+   or moved. */
+static struct rhash_elem *
+live_elem (struct rhash_slot *slot) {
+	return slot->elem != MOVED ? slot->elem : NULL;
+}
+
+/* Returns the slot in A where probing for KEY starts.  Fibonacci
+   hashing: multiplying by 2**64 divided by the golden ratio and
+   keeping the top bits mixes all of KEY's bits into the index,
+   so small integers and aligned pointers spread out as well as
+   the output of a good hash function does. */
+static inline size_t
+home (const struct rhash_array *a, uint64_t key) {
+	return (key * 0x9e3779b97f4a7c15ULL) >> a->shift;
+}
+
+/* Returns how far the element in slot IDX of A, with KEY, is from
+   its home slot. */
+static inline size_t
+distance (const struct rhash_array *a, size_t idx, uint64_t key) {
+	return (idx - home (a, key)) & (a->cnt - 1);
+}
+
+/* Initializes A with CNT empty slots.  Returns false if out of
+   memory. */
+static bool
+init_array (struct rhash_array *a, size_t cnt) {
+	struct rhash_slot *slots = calloc (cnt, sizeof *slots);
+
+	if (slots == NULL)
+		return false;
+	a->slots = slots;
+	a->cnt = cnt;
+	a->shift = 64 - __builtin_ctzl (cnt);
+	return true;
+}
+
+/* Searches A for the element with KEY that is equal to E, or, in
+   a keyed table, just the element with KEY.  Returns its slot if
+   found or a null pointer otherwise. */
+static struct rhash_slot *
+find_in (struct rhash *h, struct rhash_array *a,
+		uint64_t key, const struct rhash_elem *e) {
+	size_t mask = a->cnt - 1;
+	size_t idx = home (a, key);
+	size_t dist;
+
+	/* Robin Hood order means that no element further on could be
+	   the one sought once we have gone further from its home than
+	   the element in the slot is from its own. */
+	for (dist = 0; ; dist++, idx = (idx + 1) & mask) {
+		struct rhash_slot *slot = &a->slots[idx];
+
+		if (slot->elem == NULL || distance (a, idx, slot->key) < dist)
+			return NULL;
+		if (slot->key == key && slot->elem != MOVED
+				&& (h->equal == NULL || slot->elem == e
+					|| h->equal (slot->elem, e, h->aux)))
+			return slot;
+	}
+}
+
+/* Searches H for the element with KEY that is equal to E.
+   Returns its slot if found or a null pointer otherwise. */
+static struct rhash_slot *
+find_slot (struct rhash *h, uint64_t key, const struct rhash_elem *e) {
+	struct rhash_slot *slot = find_in (h, &h->cur, key, e);
+
+	if (slot == NULL && h->old.slots != NULL)
+		slot = find_in (h, &h->old, key, e);
+	return slot;
+}
+
+/* Inserts E, whose KEY member is set, into H, which must not
+   contain an equal element. */
+static void
+insert_elem (struct rhash *h, struct rhash_elem *e) {
+	/* Move some of the old array across, then grow if E would
+	   make the table too full.  If growing fails, carry on as long
+	   as an empty slot would remain: that's slower but still
+	   correct. */
+	migrate (h, MIGRATE_SLOTS);
+	if (h->elem_cnt + 1 > GROW_LOAD (h->cur.cnt)
+			&& !resize (h, h->cur.cnt * 2)
+			&& h->elem_cnt + 1 >= h->cur.cnt)
+		PANIC ("rhash: out of memory with %zu elements", h->elem_cnt);
+
+	place (&h->cur, e->key, e);
+	h->elem_cnt++;
+}
+
+/* Puts E, with KEY, into A, which must have an empty slot and no
+   moved ones. */
+static void
+place (struct rhash_array *a, uint64_t key, struct rhash_elem *e) {
+	size_t mask = a->cnt - 1;
+	size_t idx = home (a, key);
+	size_t dist;
+
+	for (dist = 0; ; dist++, idx = (idx + 1) & mask) {
+		struct rhash_slot *slot = &a->slots[idx];
+		size_t slot_dist;
+
+		if (slot->elem == NULL) {
+			slot->key = key;
+			slot->elem = e;
+			return;
+		}
+
+		/* Take from the rich: the resident is nearer its home
+		   than E is, so E takes its slot and it moves on. */
+		slot_dist = distance (a, idx, slot->key);
+		if (slot_dist < dist) {
+			struct rhash_slot displaced = *slot;
+
+			slot->key = key;
+			slot->elem = e;
+			key = displaced.key;
+			e = displaced.elem;
+			dist = slot_dist;
+		}
+	}
+}
+
+/* Removes the element in SLOT from H, and shrinks H if it is
+   now too empty. */
+static void
+remove_slot (struct rhash *h, struct rhash_slot *slot) {
+	struct rhash_array *a = &h->cur;
+
+	h->elem_cnt--;
+	if (slot < a->slots || slot >= a->slots + a->cnt) {
+		/* In the old array, which only ever loses elements. */
+		slot->elem = MOVED;
+	} else {
+		/* Shift back each following element that is away from
+		   home, up to the next empty slot or element that is at
+		   home, so that no probe sequence runs into a gap. */
+		size_t mask = a->cnt - 1;
+		size_t idx = slot - a->slots;
+
+		for (;;) {
+			size_t next = (idx + 1) & mask;
+			struct rhash_slot *s = &a->slots[next];
+
+			if (s->elem == NULL || distance (a, next, s->key) == 0)
+				break;
+			a->slots[idx] = *s;
+			idx = next;
+		}
+		a->slots[idx].elem = NULL;
+	}
+
+	/* Shrinking is only for saving memory, so if it fails we
+	   simply stay bigger. */
+	migrate (h, MIGRATE_SLOTS);
+	if (a->cnt > MIN_SLOTS && h->elem_cnt < SHRINK_LOAD (a->cnt))
+		resize (h, a->cnt / 2);
+}
+
+/* Moves up to SLOT_CNT slots' worth of elements from H's old
+   array into its current one, and frees the old array once it is
+   empty. */
+static void
+migrate (struct rhash *h, size_t slot_cnt) {
+	while (h->old.slots != NULL && slot_cnt-- > 0) {
+		struct rhash_slot *slot = &h->old.slots[h->old_idx++];
+		struct rhash_elem *e = live_elem (slot);
+
+		if (e != NULL) {
+			place (&h->cur, slot->key, e);
+			slot->elem = MOVED;
+		}
+		if (h->old_idx == h->old.cnt) {
+			free (h->old.slots);
+			h->old.slots = NULL;
+			h->old.cnt = 0;
+		}
+	}
+}
+
+/* Starts moving H's elements into a new array of CNT slots.
+   Returns false, leaving H as it was, if out of memory. */
+static bool
+resize (struct rhash *h, size_t cnt) {
+	struct rhash_array new;
+
+	/* Finish any earlier resize first: only one array can be
+	   draining at a time. */
+	migrate (h, SIZE_MAX);
+
+	if (!init_array (&new, cnt))
+		return false;
+	h->old = h->cur;
+	h->old_idx = 0;
+	h->cur = new;
+	return true;
+}
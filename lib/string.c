@@ -1,5 +1,60 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* The block functions below move 8 bytes at a time with the
+   string instructions, `rep movsq' and `rep stosq', and take care
+   of the unaligned bytes at either end with `rep movsb' and
+   `rep stosb'.  Everything is built with -mno-sse, so there is no
+   SSE path. */
+
+/* Blocks at least this long are worth aligning first. */
+#define ALIGN_MIN 32
+
+/* A 64-bit word that may alias anything, for memcmp(). */
+typedef uint64_t __attribute__ ((__may_alias__)) word_t;
+
+/* Copies SIZE bytes from SRC to DST, front to back. */
+static inline void
+copy_forward (unsigned char *dst, const unsigned char *src, size_t size) {
+	if (size >= ALIGN_MIN) {
+		/* Bytes up to DST's first 8-byte boundary, then words. */
+		size_t head = -(uintptr_t) dst & 7;
+		size_t words = (size - head) / 8;
+
+		size = (size - head) % 8;
+		asm volatile ("rep movsb"
+				: "+D" (dst), "+S" (src), "+c" (head) : : "memory");
+		asm volatile ("rep movsq"
+				: "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+	}
+	asm volatile ("rep movsb"
+			: "+D" (dst), "+S" (src), "+c" (size) : : "memory");
+}
+
+/* Copies SIZE bytes from SRC to DST, back to front.  With the
+   direction flag set, the string instructions step downward from
+   the last element: first the bytes past the last whole word, then
+   the words.  The ABI wants the flag clear whenever compiled code
+   runs, so it is set and cleared within the one asm statement. */
+static inline void
+copy_backward (unsigned char *dst, const unsigned char *src, size_t size) {
+	size_t tail = size % 8;
+	size_t words = size / 8;
+	unsigned char *d = dst + size - 1;
+	const unsigned char *s = src + size - 1;
+
+	asm volatile ("std\n\t"
+			"rep movsb\n\t"
+			"sub $7, %%rdi\n\t"
+			"sub $7, %%rsi\n\t"
+			"mov %3, %%rcx\n\t"
+			"rep movsq\n\t"
+			"cld"
+			: "+D" (d), "+S" (s), "+c" (tail)
+			: "r" (words)
+			: "cc", "memory");
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -11,8 +66,7 @@ memcpy (void *dst_, const void *src_, size_t size) {
 	ASSERT (dst != NULL || size == 0);
 	ASSERT (src != NULL || size == 0);
 
-	while (size-- > 0)
-		*dst++ = *src++;
+	copy_forward (dst, src, size);
 
 	return dst_;
 }
@@ -27,17 +81,14 @@ memmove (void *dst_, const void *src_, size_t size) {
 	ASSERT (dst != NULL || size == 0);
 	ASSERT (src != NULL || size == 0);
 
-	if (dst < src) {
-		while (size-- > 0)
-			*dst++ = *src++;
-	} else {
-		dst += size;
-		src += size;
-		while (size-- > 0)
-			*--dst = *--src;
-	}
+	/* Only a DST that starts inside SRC has to be copied back to
+	   front. */
+	if (dst <= src || dst >= src + size)
+		copy_forward (dst, src, size);
+	else
+		copy_backward (dst, src, size);
 
-	return dst;
+	return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -52,6 +103,10 @@ memcmp (const void *a_, const void *b_, size_t size) {
 	ASSERT (a != NULL || size == 0);
 	ASSERT (b != NULL || size == 0);
 
+	/* Skip over equal words, then find the differing byte. */
+	for (; size >= 8; a += 8, b += 8, size -= 8)
+		if (*(const word_t *) a != *(const word_t *) b)
+			break;
 	for (; size-- > 0; a++, b++)
 		if (*a != *b)
 			return *a > *b ? +1 : -1;
@@ -257,11 +312,23 @@ strtok_r (char *s, const char *delimiters, char **save_ptr) {
 void *
 memset (void *dst_, int value, size_t size) {
 	unsigned char *dst = dst_;
+	uint64_t pattern = (unsigned char) value * 0x0101010101010101ULL;
 
 	ASSERT (dst != NULL || size == 0);
 
-	while (size-- > 0)
-		*dst++ = value;
+	if (size >= ALIGN_MIN) {
+		/* Bytes up to DST's first 8-byte boundary, then words. */
+		size_t head = -(uintptr_t) dst & 7;
+		size_t words = (size - head) / 8;
+
+		size = (size - head) % 8;
+		asm volatile ("rep stosb"
+				: "+D" (dst), "+c" (head) : "a" (pattern) : "memory");
+		asm volatile ("rep stosq"
+				: "+D" (dst), "+c" (words) : "a" (pattern) : "memory");
+	}
+	asm volatile ("rep stosb"
+			: "+D" (dst), "+c" (size) : "a" (pattern) : "memory");
 
 	return dst_;
 }
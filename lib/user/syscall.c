@@ -54,7 +54,7 @@ static __inline int64_t syscall (uint64_t num_, uint64_t a1_, uint64_t a2_,
 			((uint64_t) ARG2), 0, 0, 0))
 
 #define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3) ( \
-		syscall(((uint64_t *) NUMBER), \
+		syscall(((uint64_t) NUMBER), \
 			((uint64_t) ARG0), \
 			((uint64_t) ARG1), \
 			((uint64_t) ARG2), \
@@ -90,11 +90,36 @@ exec (const char *file) {
 	return (pid_t) syscall1 (SYS_EXEC, file);
 }
 
+pid_t
+spawn (const char *file, char *const argv[]) {
+	return (pid_t) syscall2 (SYS_SPAWN, file, argv);
+}
+
+/* The child of vfork() returns from it and goes on to call other
+   functions on the parent's stack, overwriting the return address the
+   parent will later return through.  So keep the return address in
+   %rdx instead, which the kernel preserves across the system call, and
+   jump through it. */
+__attribute__ ((naked)) pid_t
+vfork (const char *thread_name UNUSED) {
+	__asm __volatile(
+			"popq %%rdx\n"
+			"movq %0, %%rax\n"
+			"syscall\n"
+			"jmp *%%rdx\n"
+			: : "i" (SYS_VFORK));
+}
+
 int
 wait (pid_t pid) {
 	return syscall1 (SYS_WAIT, pid);
 }
 
+pid_t
+wait_any (int *status) {
+	return (pid_t) syscall1 (SYS_WAIT_ANY, status);
+}
+
 bool
 create (const char *file, unsigned initial_size) {
 	return syscall2 (SYS_CREATE, file, initial_size);
@@ -145,6 +170,31 @@ dup2 (int oldfd, int newfd){
 	return syscall2 (SYS_DUP2, oldfd, newfd);
 }
 
+int
+pipe (int fds[2]) {
+	return syscall1 (SYS_PIPE, fds);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt) {
+	return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt) {
+	return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+pread (int fd, void *buffer, unsigned size, off_t offset) {
+	return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, off_t offset) {
+	return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
 void *
 mmap (void *addr, size_t length, int writable, int fd, off_t offset) {
 	return (void *) syscall5 (SYS_MMAP, addr, length, writable, fd, offset);
@@ -155,6 +205,31 @@ munmap (void *addr) {
 	syscall1 (SYS_MUNMAP, addr);
 }
 
+int
+sysstat (int nr, struct sysstat *st) {
+	return syscall2 (SYS_SYSSTAT, nr, st);
+}
+
+int
+clock_gettime (clockid_t clock, struct timespec *ts) {
+	return syscall2 (SYS_CLOCK_GETTIME, clock, ts);
+}
+
+int
+intrstat (int vec, struct intrstat *st) {
+	return syscall2 (SYS_INTRSTAT, vec, st);
+}
+
+struct io_ring *
+io_setup (void) {
+	return (struct io_ring *) syscall0 (SYS_IO_SETUP);
+}
+
+int
+io_enter (unsigned to_submit) {
+	return syscall1 (SYS_IO_ENTER, to_submit);
+}
+
 bool
 chdir (const char *dir) {
 	return syscall1 (SYS_CHDIR, dir);
@@ -0,0 +1,337 @@
+/* Test program for lib/kernel/rhash.c, and benchmark against
+   lib/kernel/hash.c.
+
+   Checks the open-addressed table, both with hash and comparison
+   functions and keyed, against a reference array through a long
+   run of random insertions, deletions and lookups that grows and
+   shrinks it repeatedly.  Then times insertion, successful and
+   unsuccessful lookup, and deletion of the same integer keys in
+   the chained table and in both kinds of open-addressed table,
+   reporting TSC cycles per operation and the longest single
+   insertion, which is where rehashing shows up.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <hash.h>
+#include <inttypes.h>
+#include <random.h>
+#include <rhash.h>
+#include <stdio.h>
+#include "threads/malloc.h"
+#include "threads/test.h"
+#include "intrinsic.h"
+
+/* Number of distinct keys in the check, and operations on them. */
+#define CHECK_KEYS 1024
+#define CHECK_OPS 200000
+
+/* Number of elements in the benchmark. */
+#define BENCH_CNT 16384
+
+/* An element of all three kinds of table at once. */
+struct value
+  {
+    struct hash_elem h_elem;    /* Chained table element. */
+    struct rhash_elem r_elem;   /* Open-addressed table element. */
+    int key;                    /* Key. */
+  };
+
+RHASH_KEYED (value, struct value, r_elem, int)
+
+static void check (bool keyed);
+static void bench (void);
+
+static struct value *values;
+
+void
+test (void)
+{
+  values = malloc (sizeof *values * BENCH_CNT);
+  ASSERT (values != NULL);
+
+  printf ("checking rhash...");
+  check (false);
+  check (true);
+  printf (" done\n");
+
+  bench ();
+  free (values);
+  printf ("hash: PASS\n");
+}
+
+static uint64_t
+value_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct value, h_elem)->key);
+}
+
+static bool
+value_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct value, h_elem)->key
+          < hash_entry (b, struct value, h_elem)->key);
+}
+
+static uint64_t
+value_rhash (const struct rhash_elem *e, void *aux UNUSED)
+{
+  return hash_int (rhash_entry (e, struct value, r_elem)->key);
+}
+
+static bool
+value_equal (const struct rhash_elem *a, const struct rhash_elem *b,
+             void *aux UNUSED)
+{
+  return (rhash_entry (a, struct value, r_elem)->key
+          == rhash_entry (b, struct value, r_elem)->key);
+}
+
+/* Looks up KEY in H, which is KEYED or not. */
+static struct value *
+find (struct rhash *h, bool keyed, int key)
+{
+  struct value probe;
+  struct rhash_elem *e;
+
+  if (keyed)
+    return value_find (h, key);
+  probe.key = key;
+  e = rhash_find (h, &probe.r_elem);
+  return e != NULL ? rhash_entry (e, struct value, r_elem) : NULL;
+}
+
+/* Checks that H holds exactly the values marked in IN. */
+static void
+verify (struct rhash *h, const bool in[CHECK_KEYS])
+{
+  struct rhash_iterator i;
+  size_t cnt = 0, expected = 0;
+  int k;
+
+  rhash_first (&i, h);
+  while (rhash_next (&i))
+    {
+      struct value *v = rhash_entry (rhash_cur (&i), struct value, r_elem);
+      ASSERT (in[v - values]);
+      cnt++;
+    }
+  for (k = 0; k < CHECK_KEYS; k++)
+    expected += in[k];
+  ASSERT (cnt == expected);
+  ASSERT (rhash_size (h) == expected);
+}
+
+/* Runs random operations on a table, KEYED or not, checking each
+   result against a reference.  Phases alternate between mostly
+   inserting and mostly deleting, so that the table grows and
+   shrinks, often in the middle of moving to a new array. */
+static void
+check (bool keyed)
+{
+  static bool in[CHECK_KEYS];
+  struct rhash h;
+  int op, k;
+
+  ASSERT (keyed ? rhash_init_keyed (&h)
+          : rhash_init (&h, value_rhash, value_equal, NULL));
+  for (k = 0; k < CHECK_KEYS; k++)
+    {
+      values[k].key = k * 3 - CHECK_KEYS;
+      in[k] = false;
+    }
+
+  for (op = 0; op < CHECK_OPS; op++)
+    {
+      bool growing = op / 5000 % 2 == 0;
+      int choice = random_ulong () % 10;
+      struct value *v;
+
+      k = random_ulong () % CHECK_KEYS;
+      v = &values[k];
+      if (choice < (growing ? 5 : 2))
+        {
+          struct rhash_elem *old;
+
+          if (keyed)
+            {
+              struct value *o = value_insert (&h, v, v->key);
+              old = o != NULL ? &o->r_elem : NULL;
+            }
+          else
+            old = rhash_insert (&h, &v->r_elem);
+          ASSERT (old == (in[k] ? &v->r_elem : NULL));
+          in[k] = true;
+        }
+      else if (choice < 7)
+        {
+          struct value *old;
+
+          if (in[k] && choice == 6)
+            {
+              rhash_remove (&h, &v->r_elem);
+              old = v;
+            }
+          else if (keyed)
+            old = value_delete (&h, v->key);
+          else
+            {
+              struct value probe;
+              struct rhash_elem *e;
+
+              probe.key = v->key;
+              e = rhash_delete (&h, &probe.r_elem);
+              old = e != NULL ? rhash_entry (e, struct value, r_elem) : NULL;
+            }
+          ASSERT (old == (in[k] ? v : NULL));
+          in[k] = false;
+        }
+      else
+        {
+          ASSERT (find (&h, keyed, v->key) == (in[k] ? v : NULL));
+        }
+
+      if (op % 1000 == 0)
+        verify (&h, in);
+    }
+  verify (&h, in);
+  rhash_destroy (&h, NULL);
+}
+
+/* Prints the cycles per operation of BENCH_CNT operations OP on
+   TABLE that took CYCLES cycles in all, and the longest single
+   one, MAX, if it is nonzero. */
+static void
+report (const char *table, const char *op, uint64_t cycles, uint64_t max)
+{
+  printf ("%-8s %-12s %6"PRIu64" cycles/op", table, op, cycles / BENCH_CNT);
+  if (max != 0)
+    printf (", longest %"PRIu64, max);
+  printf ("\n");
+}
+
+/* Shuffles the keys of the first CNT values. */
+static void
+shuffle (int cnt)
+{
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      int j = random_ulong () % cnt;
+      int t = values[i].key;
+      values[i].key = values[j].key;
+      values[j].key = t;
+    }
+}
+
+/* Times the chained table. */
+static void
+bench_hash (void)
+{
+  struct hash h;
+  struct value probe;
+  uint64_t start, max = 0;
+  int i;
+
+  ASSERT (hash_init (&h, value_hash, value_less, NULL));
+
+  start = rdtsc ();
+  for (i = 0; i < BENCH_CNT; i++)
+    {
+      uint64_t t = rdtsc ();
+      hash_insert (&h, &values[i].h_elem);
+      t = rdtsc () - t;
+      if (t > max)
+        max = t;
+    }
+  report ("hash", "insert", rdtsc () - start, max);
+
+  start = rdtsc ();
+  for (i = 0; i < BENCH_CNT; i++)
+    ASSERT (hash_find (&h, &values[i].h_elem) != NULL);
+  report ("hash", "find", rdtsc () - start, 0);
+
+  start = rdtsc ();
+  for (i = 0; i < BENCH_CNT; i++)
+    {
+      probe.key = values[i].key + 1;
+      ASSERT (hash_find (&h, &probe.h_elem) == NULL);
+    }
+  report ("hash", "find missing", rdtsc () - start, 0);
+
+  start = rdtsc ();
+  for (i = 0; i < BENCH_CNT; i++)
+    ASSERT (hash_delete (&h, &values[i].h_elem) != NULL);
+  report ("hash", "delete", rdtsc () - start, 0);
+
+  hash_destroy (&h, NULL);
+}
+
+/* Times the open-addressed table, KEYED or not. */
+static void
+bench_rhash (bool keyed)
+{
+  const char *name = keyed ? "rhash/k" : "rhash";
+  struct rhash h;
+  uint64_t start, max = 0;
+  int i;
+
+  ASSERT (keyed ? rhash_init_keyed (&h)
+          : rhash_init (&h, value_rhash, value_equal, NULL));
+
+  start = rdtsc ();
+  for (i = 0; i < BENCH_CNT; i++)
+    {
+      uint64_t t = rdtsc ();
+      if (keyed)
+        value_insert (&h, &values[i], values[i].key);
+      else
+        rhash_insert (&h, &values[i].r_elem);
+      t = rdtsc () - t;
+      if (t > max)
+        max = t;
+    }
+  report (name, "insert", rdtsc () - start, max);
+
+  start = rdtsc ();
+  for (i = 0; i < BENCH_CNT; i++)
+    ASSERT (find (&h, keyed, values[i].key) != NULL);
+  report (name, "find", rdtsc () - start, 0);
+
+  start = rdtsc ();
+  for (i = 0; i < BENCH_CNT; i++)
+    ASSERT (find (&h, keyed, values[i].key + 1) == NULL);
+  report (name, "find missing", rdtsc () - start, 0);
+
+  start = rdtsc ();
+  for (i = 0; i < BENCH_CNT; i++)
+    {
+      bool found = (keyed ? value_delete (&h, values[i].key) != NULL
+                    : rhash_delete (&h, &values[i].r_elem) != NULL);
+      ASSERT (found);
+    }
+  report (name, "delete", rdtsc () - start, 0);
+
+  rhash_destroy (&h, NULL);
+}
+
+/* Times each table on the same BENCH_CNT even keys, so that odd
+   ones are missing. */
+static void
+bench (void)
+{
+  int i;
+
+  for (i = 0; i < BENCH_CNT; i++)
+    values[i].key = i * 2;
+  shuffle (BENCH_CNT);
+
+  bench_hash ();
+  bench_rhash (false);
+  bench_rhash (true);
+}
@@ -0,0 +1,167 @@
+/* Test program for the block functions in lib/string.c.
+
+   Checks memcpy(), memmove(), memset() and memcmp() against
+   byte-at-a-time reference versions for every combination of
+   small sizes and misalignments, then times each of them on
+   large blocks and reports bytes per TSC cycle.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/test.h"
+#include "intrinsic.h"
+
+/* Largest size checked against the reference versions. */
+#define CHECK_SIZE 100
+
+/* Size of the blocks timed, and the number of times each is. */
+#define BENCH_SIZE 4096
+#define BENCH_ROUNDS 1000
+
+static uint8_t buf_a[BENCH_SIZE + 16];
+static uint8_t buf_b[BENCH_SIZE + 16];
+static uint8_t ref[BENCH_SIZE + 16];
+
+static void check_copies (void);
+static void check_memset (void);
+static void check_memcmp (void);
+static void bench (void);
+
+void
+test (void)
+{
+  printf ("checking memcpy, memmove, memset, memcmp...");
+  check_copies ();
+  check_memset ();
+  check_memcmp ();
+  printf (" done\n");
+
+  bench ();
+  printf ("string: PASS\n");
+}
+
+/* Checks memcpy() and memmove(), the latter in both directions
+   within a single buffer, at every offset and size. */
+static void
+check_copies (void)
+{
+  size_t dst_ofs, src_ofs, size, i;
+
+  for (dst_ofs = 0; dst_ofs < 8; dst_ofs++)
+    for (src_ofs = 0; src_ofs < 8; src_ofs++)
+      for (size = 0; size <= CHECK_SIZE; size++)
+        {
+          random_bytes (buf_a, sizeof buf_a);
+          random_bytes (buf_b, sizeof buf_b);
+          memcpy (ref, buf_b, sizeof ref);
+          for (i = 0; i < size; i++)
+            ref[dst_ofs + i] = buf_a[src_ofs + i];
+          ASSERT (memcpy (buf_b + dst_ofs, buf_a + src_ofs, size)
+                  == buf_b + dst_ofs);
+          for (i = 0; i < sizeof ref; i++)
+            ASSERT (buf_b[i] == ref[i]);
+
+          /* Overlapping, destination before and after source. */
+          memcpy (buf_b, buf_a, sizeof buf_b);
+          memcpy (ref, buf_a, sizeof ref);
+          for (i = 0; i < size; i++)
+            ref[dst_ofs + i] = buf_a[src_ofs + i];
+          ASSERT (memmove (buf_b + dst_ofs, buf_b + src_ofs, size)
+                  == buf_b + dst_ofs);
+          for (i = 0; i < sizeof ref; i++)
+            ASSERT (buf_b[i] == ref[i]);
+        }
+}
+
+/* Checks memset() at every offset and size. */
+static void
+check_memset (void)
+{
+  size_t ofs, size, i;
+
+  for (ofs = 0; ofs < 8; ofs++)
+    for (size = 0; size <= CHECK_SIZE; size++)
+      {
+        int value = random_ulong () % 256;
+
+        random_bytes (buf_a, sizeof buf_a);
+        memcpy (ref, buf_a, sizeof ref);
+        for (i = 0; i < size; i++)
+          ref[ofs + i] = value;
+        ASSERT (memset (buf_a + ofs, value, size) == buf_a + ofs);
+        for (i = 0; i < sizeof ref; i++)
+          ASSERT (buf_a[i] == ref[i]);
+      }
+}
+
+/* Checks memcmp() with a single differing byte at every
+   position, in either direction, and with none. */
+static void
+check_memcmp (void)
+{
+  size_t ofs, size, diff;
+
+  for (ofs = 0; ofs < 8; ofs++)
+    for (size = 0; size <= CHECK_SIZE; size++)
+      {
+        random_bytes (buf_a, sizeof buf_a);
+        memcpy (buf_b, buf_a, sizeof buf_b);
+        ASSERT (memcmp (buf_a + ofs, buf_b + ofs, size) == 0);
+        for (diff = 0; diff < size; diff++)
+          {
+            buf_a[ofs + diff] = 1;
+            buf_b[ofs + diff] = 2;
+            ASSERT (memcmp (buf_a + ofs, buf_b + ofs, size) < 0);
+            ASSERT (memcmp (buf_b + ofs, buf_a + ofs, size) > 0);
+            buf_b[ofs + diff] = 1;
+          }
+      }
+}
+
+/* Prints the bytes per cycle achieved by moving BENCH_ROUNDS
+   blocks of BENCH_SIZE bytes in CYCLES cycles. */
+static void
+report (const char *name, uint64_t cycles)
+{
+  uint64_t bytes = (uint64_t) BENCH_SIZE * BENCH_ROUNDS;
+
+  printf ("%-8s %"PRIu64".%02"PRIu64" bytes/cycle\n", name,
+          bytes / cycles, bytes * 100 / cycles % 100);
+}
+
+/* Times each function on page-sized blocks. */
+static void
+bench (void)
+{
+  uint64_t start;
+  int i;
+
+  start = rdtsc ();
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    memcpy (buf_b, buf_a, BENCH_SIZE);
+  report ("memcpy", rdtsc () - start);
+
+  start = rdtsc ();
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    memmove (buf_a + 8, buf_a, BENCH_SIZE);
+  report ("memmove", rdtsc () - start);
+
+  start = rdtsc ();
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    memset (buf_a, i, BENCH_SIZE);
+  report ("memset", rdtsc () - start);
+
+  memcpy (buf_b, buf_a, BENCH_SIZE);
+  start = rdtsc ();
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    ASSERT (memcmp (buf_a, buf_b, BENCH_SIZE) == 0);
+  report ("memcmp", rdtsc () - start);
+}
@@ -0,0 +1,41 @@
+/* Reads the monotonic clock over and over and checks that it never
+   goes backward, that its nanoseconds stay in range, and that it
+   moves at all.  Any other clock must be refused. */
+
+#include <syscall.h>
+#include <time.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int64_t
+to_ns (const struct timespec *ts)
+{
+  return ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+void
+test_main (void)
+{
+  struct timespec ts;
+  int64_t first, prev;
+  int i;
+
+  CHECK (clock_gettime (CLOCK_MONOTONIC, &ts) == 0,
+         "clock_gettime(CLOCK_MONOTONIC)");
+  first = prev = to_ns (&ts);
+  for (i = 0; i < 100000; i++)
+    {
+      if (clock_gettime (CLOCK_MONOTONIC, &ts) != 0)
+        fail ("clock_gettime failed on call %d", i);
+      if (ts.tv_nsec < 0 || ts.tv_nsec >= 1000000000)
+        fail ("tv_nsec out of range: %lld", ts.tv_nsec);
+      if (to_ns (&ts) < prev)
+        fail ("clock went backward by %lld ns", prev - to_ns (&ts));
+      prev = to_ns (&ts);
+    }
+  if (prev == first)
+    fail ("clock did not move");
+  msg ("clock is monotonic");
+
+  CHECK (clock_gettime (0, &ts) == -1, "clock_gettime(0) must fail");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(clock-gettime) begin
+(clock-gettime) clock_gettime(CLOCK_MONOTONIC)
+(clock-gettime) clock is monotonic
+(clock-gettime) clock_gettime(0) must fail
+(clock-gettime) end
+clock-gettime: exit(0)
+EOF
+pass;
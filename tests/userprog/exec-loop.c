@@ -0,0 +1,62 @@
+/* Executes itself over and over, as many times as the first
+   command-line argument says, and reports how long an exec() takes.
+   Each exec() replaces the process rather than forking a new one, so
+   this times exec() alone: tearing down the old image, loading the
+   same executable again and setting up its arguments.  The time of
+   the first exec() is handed down the chain on the command line. */
+
+#include <debug.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <syscall.h>
+#include <syscall-nr.h>
+#include <sysstat.h>
+#include <time.h>
+#include "tests/lib.h"
+
+/* Returns the nonnegative decimal number in S. */
+static long long
+parse_ll (const char *s)
+{
+  long long n = 0;
+
+  while (*s >= '0' && *s <= '9')
+    n = n * 10 + (*s++ - '0');
+  return n;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int total = atoi (argv[1]);
+  int left = argc > 2 ? atoi (argv[2]) : total;
+  struct sysstat st;
+  struct timespec ts;
+  long long now, start;
+
+  test_name = "exec-loop";
+  if (left == total)
+    msg ("begin");
+  if (clock_gettime (CLOCK_MONOTONIC, &ts) != 0)
+    fail ("clock_gettime failed");
+  now = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+  start = argc > 3 ? parse_ll (argv[3]) : now;
+  if (left > 0)
+    {
+      char cmd[96];
+
+      /* Pad with a few extra arguments so that argument passing is
+         part of what gets timed. */
+      snprintf (cmd, sizeof cmd, "exec-loop %d %d %lld a b c d e f", total,
+                left - 1, start);
+      exec (cmd);
+      fail ("exec(\"%s\") returned", cmd);
+    }
+
+  CHECK (sysstat (SYS_EXEC, &st) == 0, "sysstat(SYS_EXEC)");
+  if (st.calls != total)
+    fail ("%lld exec() calls counted, expected %d", st.calls, total);
+  msg ("%d execs, %lld ns per exec", total, (now - start) / total);
+  msg ("end");
+  return 0;
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+# The timing line varies from run to run.
+@output = grep (!/^\(exec-loop\) \d+ execs, \d+ ns per exec$/, @output);
+
+compare_output ("run", \@output, [<<'EOF']);
+(exec-loop) begin
+(exec-loop) sysstat(SYS_EXEC)
+(exec-loop) end
+exec-loop: exit(0)
+EOF
+pass;
@@ -0,0 +1,74 @@
+/* Loads a value into an x87 and an SSE register, then forks
+   children that check they inherited it, load values of their own
+   and keep checking them while the timer switches among them and
+   the parent, which checks its own all the while.  The registers
+   are never saved by user code, so each process only finds its
+   values intact if the kernel switches FPU state along with it. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 4
+#define ROUNDS 500000
+#define PARENT_VALUE 0x1234567890abcdLL
+
+/* Pushes VALUE onto the x87 stack and puts it in %xmm0. */
+static void
+set_regs (int64_t value)
+{
+  asm volatile ("fildq %0" : : "m" (value));
+  asm volatile ("movq %0, %%xmm0" : : "r" (value));
+}
+
+/* Returns true if the top of the x87 stack and %xmm0 both hold
+   VALUE. */
+static bool
+regs_hold (int64_t value)
+{
+  int64_t x87, sse;
+
+  asm volatile ("fld %%st(0); fistpq %0" : "=m" (x87));
+  asm volatile ("movq %%xmm0, %0" : "=r" (sse));
+  return x87 == value && sse == value;
+}
+
+/* Checks ROUNDS times that the registers hold VALUE. */
+static bool
+keep_checking (int64_t value)
+{
+  int i;
+
+  for (i = 0; i < ROUNDS; i++)
+    if (!regs_hold (value))
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  pid_t children[CHILD_CNT];
+  int i;
+
+  set_regs (PARENT_VALUE);
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      children[i] = fork ("child");
+      if (children[i] == 0)
+        {
+          int64_t value = PARENT_VALUE * (i + 2);
+
+          if (!regs_hold (PARENT_VALUE))
+            exit (1);
+          set_regs (value);
+          exit (keep_checking (value) ? 0 : 2);
+        }
+      else if (children[i] == -1)
+        fail ("fork child %d", i);
+    }
+  CHECK (keep_checking (PARENT_VALUE), "parent's registers intact");
+  for (i = 0; i < CHILD_CNT; i++)
+    CHECK (wait (children[i]) == 0, "child %d's registers intact", i);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fpu-switch) begin
+(fpu-switch) parent's registers intact
+(fpu-switch) child 0's registers intact
+(fpu-switch) child 1's registers intact
+(fpu-switch) child 2's registers intact
+(fpu-switch) child 3's registers intact
+(fpu-switch) end
+EOF
+pass;
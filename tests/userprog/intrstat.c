@@ -0,0 +1,49 @@
+/* Spins long enough for several timer interrupts to arrive and
+   checks that intrstat() counted them, and that the kernel has
+   turned interrupts off and back on at least once along the way.
+   Vectors out of range must be refused. */
+
+#include <intrstat.h>
+#include <syscall.h>
+#include <time.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int64_t
+now_ns (void)
+{
+  struct timespec ts;
+
+  if (clock_gettime (CLOCK_MONOTONIC, &ts) != 0)
+    fail ("clock_gettime failed");
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void
+test_main (void)
+{
+  struct intrstat pit, lapic, off;
+  int64_t start;
+
+  start = now_ns ();
+  while (now_ns () - start < 30000000)
+    continue;
+
+  /* The timer is the 8254 or the local APIC's, whichever the
+     kernel found. */
+  CHECK (intrstat (0x20, &pit) == 0, "intrstat(0x20)");
+  CHECK (intrstat (0x30, &lapic) == 0, "intrstat(0x30)");
+  if (pit.count + lapic.count <= 0)
+    fail ("no timer interrupts counted");
+  if (lapic.count > 0 && lapic.max_cycles == 0)
+    fail ("timer interrupts took no time");
+  msg ("timer interrupts counted");
+
+  CHECK (intrstat (INTRSTAT_OFF, &off) == 0, "intrstat(INTRSTAT_OFF)");
+  if (off.count <= 0 || off.max_site == 0)
+    fail ("no spans with interrupts off counted");
+  msg ("spans with interrupts off counted");
+
+  CHECK (intrstat (256, &off) == -1, "intrstat(256) must fail");
+  CHECK (intrstat (-2, &off) == -1, "intrstat(-2) must fail");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(intrstat) begin
+(intrstat) intrstat(0x20)
+(intrstat) intrstat(0x30)
+(intrstat) timer interrupts counted
+(intrstat) intrstat(INTRSTAT_OFF)
+(intrstat) spans with interrupts off counted
+(intrstat) intrstat(256) must fail
+(intrstat) intrstat(-2) must fail
+(intrstat) end
+intrstat: exit(0)
+EOF
+pass;
@@ -0,0 +1,47 @@
+/* Opens the same file 3000 times, more than fit in a new
+   descriptor table, then checks that each close frees the
+   descriptor for the next open, which must always get the
+   lowest free one. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define OPEN_CNT 3000
+
+static int handles[OPEN_CNT];
+
+void
+test_main (void) 
+{
+  int i;
+
+  for (i = 0; i < OPEN_CNT; i++)
+    {
+      handles[i] = open ("sample.txt");
+      if (handles[i] < 2)
+        fail ("open #%d returned %d", i, handles[i]);
+      if (i > 0 && handles[i] != handles[i - 1] + 1)
+        fail ("open #%d returned %d after %d", i, handles[i], handles[i - 1]);
+    }
+  msg ("opened \"sample.txt\" %d times", OPEN_CNT);
+
+  for (i = OPEN_CNT - 1; i >= 0; i -= 7)
+    {
+      int fd;
+
+      close (handles[i]);
+      fd = open ("sample.txt");
+      if (fd != handles[i])
+        fail ("reopen after closing %d returned %d", handles[i], fd);
+    }
+  msg ("reopen got the lowest free descriptor");
+
+  close (handles[100]);
+  close (handles[10]);
+  CHECK (open ("sample.txt") == handles[10], "lowest of two free descriptors");
+
+  for (i = 0; i < OPEN_CNT; i++)
+    close (handles[i]);
+  CHECK (open ("sample.txt") == handles[0], "all descriptors freed");
+}
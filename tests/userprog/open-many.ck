@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(open-many) begin
+(open-many) opened "sample.txt" 3000 times
+(open-many) reopen got the lowest free descriptor
+(open-many) lowest of two free descriptors
+(open-many) all descriptors freed
+(open-many) end
+open-many: exit(0)
+EOF
+pass;
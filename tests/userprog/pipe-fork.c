@@ -0,0 +1,64 @@
+/* A child sends its parent a block of several pages through a
+   pipe in a single write, then redirects its standard output into
+   the pipe with dup2() and prints a line, the way a shell sets up
+   a pipeline.  The parent must read back exactly what was sent,
+   then end of file once the child has exited. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_SIZE (3 * 4096 + 123)
+
+static char block[BLOCK_SIZE];
+static char buf[BLOCK_SIZE];
+
+void
+test_main (void) 
+{
+  int fds[2];
+  pid_t pid;
+  char line[32];
+  size_t ofs;
+  int i, n;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  if ((pid = fork ("writer")) == 0)
+    {
+      close (fds[0]);
+      for (i = 0; i < BLOCK_SIZE; i++)
+        block[i] = i * 7 + 3;
+      if (write (fds[1], block, BLOCK_SIZE) != BLOCK_SIZE)
+        fail ("short write to pipe");
+
+      dup2 (fds[1], 1);
+      close (fds[1]);
+      printf ("hello, parent\n");
+      exit (0);
+    }
+  close (fds[1]);
+
+  for (ofs = 0; ofs < BLOCK_SIZE; ofs += n)
+    {
+      n = read (fds[0], buf + ofs, BLOCK_SIZE - ofs);
+      if (n <= 0)
+        fail ("read() returned %d after %zu bytes", n, ofs);
+    }
+  for (i = 0; i < BLOCK_SIZE; i++)
+    if (buf[i] != (char) (i * 7 + 3))
+      fail ("byte %d is %d, expected %d", i, buf[i], (char) (i * 7 + 3));
+
+  memset (line, 0, sizeof line);
+  for (ofs = 0; ofs < sizeof line - 1; ofs += n)
+    if ((n = read (fds[0], line + ofs, sizeof line - 1 - ofs)) <= 0)
+      break;
+
+  msg ("received %d bytes", BLOCK_SIZE);
+  if (strcmp (line, "hello, parent\n"))
+    fail ("child printed \"%s\"", line);
+  msg ("child printed \"hello, parent\"");
+  CHECK (wait (pid) == 0, "wait for writer");
+  CHECK (read (fds[0], line, sizeof line) == 0, "end of file");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-fork) begin
+(pipe-fork) pipe
+writer: exit(0)
+(pipe-fork) received 12411 bytes
+(pipe-fork) child printed "hello, parent"
+(pipe-fork) wait for writer
+(pipe-fork) end of file
+(pipe-fork) end
+pipe-fork: exit(0)
+EOF
+pass;
@@ -0,0 +1,17 @@
+/* Reads from a file into the test's own code, which is mapped
+   read-only.  The kernel must not write there on the process's
+   behalf: the process must be terminated with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int handle;
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  read (handle, (void *) test_main, 1);
+  fail ("survived reading data into code segment");
+}
@@ -0,0 +1,98 @@
+/* Writes a 32 kB file with writev(), then reads it back three
+   ways: with a loop of small read() calls, with readv() over the
+   same small buffers, and with pread().  All three must see the
+   same data.  The readv() and pread() passes take one system
+   call and one lock acquisition for what costs read() 64; each
+   pass is timed and reported in ns per byte. */
+
+#include <string.h>
+#include <syscall.h>
+#include <time.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHUNK 512
+#define CHUNK_CNT 64
+#define SIZE (CHUNK * CHUNK_CNT)
+
+static char expected[SIZE];
+static char actual[SIZE];
+
+/* Returns the monotonic clock in nanoseconds. */
+static long long
+now_ns (void)
+{
+  struct timespec ts;
+
+  if (clock_gettime (CLOCK_MONOTONIC, &ts) != 0)
+    fail ("clock_gettime failed");
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Reports how long a pass of NAME over SIZE bytes took, from
+   START until now. */
+static void
+report (const char *name, long long start)
+{
+  long long ps = (now_ns () - start) * 1000 / SIZE;
+
+  msg ("%s: %lld.%03lld ns/byte", name, ps / 1000, ps % 1000);
+}
+
+void
+test_main (void)
+{
+  struct iovec iov[CHUNK_CNT];
+  long long start;
+  int handle;
+  int i;
+
+  for (i = 0; i < SIZE; i++)
+    expected[i] = i * 7 + i / CHUNK;
+  for (i = 0; i < CHUNK_CNT; i++)
+    {
+      iov[i].iov_base = expected + i * CHUNK;
+      iov[i].iov_len = CHUNK;
+    }
+
+  CHECK (create ("vector", SIZE), "create \"vector\"");
+  CHECK ((handle = open ("vector")) > 1, "open \"vector\"");
+  CHECK (writev (handle, iov, CHUNK_CNT) == SIZE, "writev \"vector\"");
+
+  /* Looped read(). */
+  seek (handle, 0);
+  memset (actual, 0, SIZE);
+  start = now_ns ();
+  for (i = 0; i < CHUNK_CNT; i++)
+    if (read (handle, actual + i * CHUNK, CHUNK) != CHUNK)
+      fail ("read chunk %d", i);
+  report ("read()", start);
+  compare_bytes (actual, expected, SIZE, 0, "vector");
+  msg ("read with read()");
+
+  /* readv() into the same chunks. */
+  seek (handle, 0);
+  memset (actual, 0, SIZE);
+  for (i = 0; i < CHUNK_CNT; i++)
+    iov[i].iov_base = actual + i * CHUNK;
+  start = now_ns ();
+  CHECK (readv (handle, iov, CHUNK_CNT) == SIZE, "readv \"vector\"");
+  report ("readv()", start);
+  compare_bytes (actual, expected, SIZE, 0, "vector");
+
+  /* pread() does not move the file position. */
+  memset (actual, 0, SIZE);
+  start = now_ns ();
+  CHECK (pread (handle, actual, SIZE, 0) == SIZE, "pread \"vector\"");
+  report ("pread()", start);
+  compare_bytes (actual, expected, SIZE, 0, "vector");
+  CHECK (tell (handle) == SIZE, "position unchanged");
+
+  /* pwrite() one chunk in the middle and read it back. */
+  memset (expected + 8 * CHUNK, 'x', CHUNK);
+  CHECK (pwrite (handle, expected + 8 * CHUNK, CHUNK, 8 * CHUNK) == CHUNK,
+         "pwrite \"vector\"");
+  CHECK (pread (handle, actual, SIZE, 0) == SIZE, "pread \"vector\"");
+  compare_bytes (actual, expected, SIZE, 0, "vector");
+  close (handle);
+}
@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+# The timing lines vary from run to run.
+@output = grep (!/^\(read-vector\) \w+\(\): \d+\.\d{3} ns\/byte$/, @output);
+
+compare_output ("run", \@output, [<<'EOF']);
+(read-vector) begin
+(read-vector) create "vector"
+(read-vector) open "vector"
+(read-vector) writev "vector"
+(read-vector) read with read()
+(read-vector) readv "vector"
+(read-vector) pread "vector"
+(read-vector) position unchanged
+(read-vector) pwrite "vector"
+(read-vector) pread "vector"
+(read-vector) end
+read-vector: exit(0)
+EOF
+pass;
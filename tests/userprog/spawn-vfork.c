@@ -0,0 +1,38 @@
+/* Starts a child with spawn(), then another with vfork() and exec(),
+   and waits for each.  spawn() passes its arguments as given, so one
+   with a space in it stays a single argument. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *argv[] = {"child-args", "with space", NULL};
+  pid_t pid;
+  int status;
+
+  msg ("spawn");
+  pid = spawn ("child-args", argv);
+  if (pid <= 0)
+    fail ("spawn() returned %d", pid);
+  if ((status = wait (pid)) != 0)
+    fail ("wait() for spawned child returned %d", status);
+
+  msg ("spawn missing file");
+  if ((pid = spawn ("no-such-file", argv)) != -1)
+    fail ("spawn() of missing file returned %d", pid);
+
+  msg ("vfork");
+  pid = vfork ("child-simple");
+  if (pid == 0)
+    {
+      exec ("child-simple");
+      fail ("exec() returned");
+    }
+  if (pid < 0)
+    fail ("vfork() returned %d", pid);
+  if ((status = wait (pid)) != 81)
+    fail ("wait() for vforked child returned %d", status);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(spawn-vfork) begin
+(spawn-vfork) spawn
+(args) begin
+(args) argc = 2
+(args) argv[0] = 'child-args'
+(args) argv[1] = 'with space'
+(args) argv[2] = null
+(args) end
+child-args: exit(0)
+(spawn-vfork) spawn missing file
+load: no-such-file: open failed
+(spawn-vfork) vfork
+(child-simple) run
+child-simple: exit(81)
+(spawn-vfork) end
+spawn-vfork: exit(0)
+EOF
+pass;
@@ -0,0 +1,50 @@
+/* Forks several children that exit at once, each with a different
+   exit code, and reaps them all with wait_any(), in whatever order
+   they exit.  Each must come back exactly once, with its own exit
+   code, after which wait_any() and wait() must return -1. */
+
+#include <stdbool.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 8
+
+void
+test_main (void)
+{
+  pid_t pids[CHILD_CNT];
+  bool reaped[CHILD_CNT];
+  int i, n, status;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pids[i] = fork ("child");
+      if (pids[i] == 0)
+        exit (i + 10);
+      if (pids[i] < 0)
+        fail ("fork() returned %d", pids[i]);
+      reaped[i] = false;
+    }
+  msg ("forked %d children", CHILD_CNT);
+
+  for (n = 0; n < CHILD_CNT; n++)
+    {
+      pid_t pid = wait_any (&status);
+
+      for (i = 0; i < CHILD_CNT; i++)
+        if (pids[i] == pid)
+          break;
+      if (i == CHILD_CNT)
+        fail ("wait_any() returned %d, not a child", pid);
+      if (reaped[i])
+        fail ("wait_any() returned child %d twice", pid);
+      if (status != i + 10)
+        fail ("child %d exited with %d, expected %d", pid, status, i + 10);
+      reaped[i] = true;
+    }
+  msg ("reaped %d children", CHILD_CNT);
+
+  CHECK (wait_any (&status) == -1, "wait_any() with no children left");
+  CHECK (wait (pids[0]) == -1, "wait() for a reaped child");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(wait-any) begin
+(wait-any) forked 8 children
+(wait-any) reaped 8 children
+(wait-any) wait_any() with no children left
+(wait-any) wait() for a reaped child
+(wait-any) end
+EOF
+pass;
@@ -0,0 +1,69 @@
+/* Opens, reads and closes sample.txt through the submission and
+   completion rings, running the read and close as one batch. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[sizeof sample];
+
+/* Queues a request on RING. */
+static void
+queue (struct io_ring *ring, enum io_op op, int fd, void *addr, size_t len,
+       uint64_t user_data)
+{
+  struct io_sqe *sqe = &ring->sq[ring->sq_tail % IO_RING_ENTRIES];
+
+  sqe->opcode = op;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t) addr;
+  sqe->len = len;
+  sqe->off = 0;
+  sqe->user_data = user_data;
+  ring->sq_tail++;
+}
+
+/* Takes the next completion off RING, checks that it belongs to
+   USER_DATA and returns its result. */
+static int64_t
+reap (struct io_ring *ring, uint64_t user_data)
+{
+  struct io_cqe *cqe;
+
+  if (ring->cq_head == ring->cq_tail)
+    fail ("completion ring empty");
+  cqe = &ring->cq[ring->cq_head++ % IO_RING_ENTRIES];
+  if (cqe->user_data != user_data)
+    fail ("completion for %llu, expected %llu",
+          (unsigned long long) cqe->user_data,
+          (unsigned long long) user_data);
+  return cqe->res;
+}
+
+void
+test_main (void)
+{
+  struct io_ring *ring;
+  size_t half = sizeof sample / 2;
+  int fd;
+
+  CHECK ((ring = io_setup ()) != NULL, "io_setup");
+
+  queue (ring, IO_OP_OPEN, 0, "sample.txt", 0, 1);
+  CHECK (io_enter (1) == 1, "submit open");
+  CHECK ((fd = reap (ring, 1)) > 1, "open \"sample.txt\"");
+
+  queue (ring, IO_OP_READ, fd, buf, half, 2);
+  queue (ring, IO_OP_READ, fd, buf + half, sizeof sample - 1 - half, 3);
+  queue (ring, IO_OP_CLOSE, fd, NULL, 0, 4);
+  CHECK (io_enter (3) == 3, "submit read, read, close");
+  CHECK (reap (ring, 2) == (int64_t) half, "first read");
+  CHECK (reap (ring, 3) == (int64_t) (sizeof sample - 1 - half), "second read");
+  CHECK (reap (ring, 4) == 0, "close");
+  CHECK (ring->sq_head == ring->sq_tail, "submission ring drained");
+
+  if (memcmp (buf, sample, sizeof sample - 1))
+    fail ("data read through the ring differs from sample.txt");
+}
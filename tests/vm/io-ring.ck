@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(io-ring) begin
+(io-ring) io_setup
+(io-ring) submit open
+(io-ring) open "sample.txt"
+(io-ring) submit read, read, close
+(io-ring) first read
+(io-ring) second read
+(io-ring) close
+(io-ring) submission ring drained
+(io-ring) end
+EOF
+pass;
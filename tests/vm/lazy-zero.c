@@ -0,0 +1,50 @@
+/* Has a child dirty half a megabyte of frames and exit, freeing
+   them.  Then reads an untouched BSS page, which may be served by
+   a shared zero page, writes one byte of it, which gives it a
+   frame of its own, and checks that the rest of the page still
+   reads as zeros. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define DIRTY_SIZE (512 * 1024)
+
+static char dirty[DIRTY_SIZE];
+static char bss[3 * PAGE_SIZE];
+
+/* Fails unless PAGE is all zeros but for byte SKIP. */
+static void
+check_page (const volatile char *page, size_t skip, const char *when)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_SIZE; i++)
+    if (i != skip && page[i] != 0)
+      fail ("byte %zu is %#x %s, not 0", i, page[i] & 0xff, when);
+}
+
+void
+test_main (void)
+{
+  volatile char *page = bss + PAGE_SIZE;
+  pid_t child = fork ("child");
+
+  if (child == 0)
+    {
+      memset (dirty, 0xcc, sizeof dirty);
+      exit (0);
+    }
+  CHECK (child > 0, "fork child");
+  CHECK (wait (child) == 0, "wait for child");
+
+  check_page (page, PAGE_SIZE, "before writing");
+  msg ("untouched page reads as zeros");
+
+  page[100] = 42;
+  check_page (page, 100, "after writing");
+  CHECK (page[100] == 42, "written byte reads back");
+  msg ("rest of page still reads as zeros");
+}
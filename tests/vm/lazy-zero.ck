@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(lazy-zero) begin
+(lazy-zero) fork child
+(lazy-zero) wait for child
+(lazy-zero) untouched page reads as zeros
+(lazy-zero) written byte reads back
+(lazy-zero) rest of page still reads as zeros
+(lazy-zero) end
+EOF
+pass;
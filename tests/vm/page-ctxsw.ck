@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+# The timing line varies from run to run.
+@output = grep (!/^\(page-ctxsw\) \d+ rounds, \d+ ns per round$/, @output);
+
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(page-ctxsw) begin
+(page-ctxsw) wait for child 0
+(page-ctxsw) wait for child 1
+(page-ctxsw) wait for child 2
+(page-ctxsw) wait for child 3
+(page-ctxsw) end
+EOF
+pass;
@@ -0,0 +1,49 @@
+/* Has a child dirty half a megabyte of frames and exit, freeing
+   them, then grows the stack by 64 kB and checks that every new
+   stack page, including those mapped ahead of the faulting
+   access, reads as zeros rather than as the child's data. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define DIRTY_SIZE (512 * 1024)
+#define STACK_SIZE (64 * 1024)
+
+static char dirty[DIRTY_SIZE];
+
+static void
+check_stack (void)
+{
+  char stack_obj[STACK_SIZE];
+  volatile char *p = stack_obj;
+  size_t i;
+
+  /* Tell the compiler the array's contents are unknown, not
+     uninitialized. */
+  asm volatile ("" : : "r" (stack_obj) : "memory");
+
+  /* The top of the array lies where earlier calls have had their
+     frames, so only check below that. */
+  for (i = 0; i < STACK_SIZE - 8192; i++)
+    if (p[i] != 0)
+      fail ("stack byte %zu is %#x, not 0", i, p[i] & 0xff);
+}
+
+void
+test_main (void)
+{
+  pid_t child = fork ("child");
+
+  if (child == 0)
+    {
+      memset (dirty, 0xcc, sizeof dirty);
+      exit (0);
+    }
+  CHECK (child > 0, "fork child");
+  CHECK (wait (child) == 0, "wait for child");
+
+  check_stack ();
+  msg ("grown stack reads as zeros");
+}
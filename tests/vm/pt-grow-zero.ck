@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(pt-grow-zero) begin
+(pt-grow-zero) fork child
+(pt-grow-zero) wait for child
+(pt-grow-zero) grown stack reads as zeros
+(pt-grow-zero) end
+EOF
+pass;
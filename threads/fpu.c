@@ -0,0 +1,248 @@
+#include "threads/fpu.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+#ifdef USERPROG
+#include "userprog/syscall.h"
+#endif
+
+/* Lazy FPU context switching.
+ *
+ * The x87, SSE and (where there is one) AVX registers are not part of
+ * struct intr_frame, and saving them at every switch would cost every
+ * thread, though most never touch them; the kernel itself is built
+ * with -mno-sse and -msoft-float.  Instead, the registers always hold
+ * the state of one thread, FPU_OWNER, and the CPU is made to trap the
+ * first FPU instruction anyone else runs: schedule() sets CR0.TS when
+ * it switches to a thread other than the owner, which turns FPU
+ * instructions into #NM (Device Not Available) exceptions.  The #NM
+ * handler saves the owner's registers to the owner's save area, loads
+ * the current thread's, makes it the owner and clears CR0.TS.  A thread
+ * that never uses the FPU never gets a save area and never pays for a
+ * save or a restore; one that is the only FPU user keeps its registers
+ * loaded across any number of switches.
+ *
+ * Save areas are written with XSAVE where the CPU has it, which covers
+ * every state component enabled in XCR0, and with FXSAVE otherwise.
+ * A thread's first FPU instruction starts it from INIT_STATE, the
+ * state after FNINIT with all vector registers zero, so it never sees
+ * what the previous owner left in the registers. */
+
+#define CR0_MP (1 << 1)                 /* CR0: WAIT obeys TS. */
+#define CR0_EM (1 << 2)                 /* CR0: emulate FPU. */
+#define CR0_TS (1 << 3)                 /* CR0: task switched. */
+#define CR0_NE (1 << 5)                 /* CR0: native FPU errors. */
+#define CR4_OSFXSR (1 << 9)             /* CR4: FXSAVE and SSE. */
+#define CR4_OSXMMEXCPT (1 << 10)        /* CR4: SSE exceptions as #XF. */
+#define CR4_OSXSAVE (1 << 18)           /* CR4: XSAVE and XCR0. */
+#define CPUID_XSAVE (1U << 26)          /* CPUID.1:ECX: XSAVE supported. */
+
+/* XCR0 state components. */
+#define XSTATE_X87 (1 << 0)
+#define XSTATE_SSE (1 << 1)
+#define XSTATE_AVX (1 << 2)
+
+#define FXSAVE_SIZE 512                 /* Size of an FXSAVE area. */
+#define STATE_ALIGN 64                  /* Alignment XSAVE needs. */
+
+/* Initial control words, at their offsets in a save area. */
+#define FCW_OFS 0
+#define FCW_INIT 0x37f                  /* All x87 exceptions masked. */
+#define MXCSR_OFS 24
+#define MXCSR_INIT 0x1f80               /* All SSE exceptions masked. */
+
+static bool use_xsave;                  /* XSAVE rather than FXSAVE? */
+static uint64_t xstate_mask;            /* Components XSAVE saves. */
+static size_t state_size;               /* Bytes in a save area. */
+static uint8_t *init_state;             /* A thread's first state. */
+
+static struct thread *fpu_owner;        /* Whose state is loaded. */
+static bool ts_set;                     /* Is CR0.TS set? */
+
+static long long restore_cnt;           /* # of states loaded by #NM. */
+
+static intr_handler_func fpu_trap;
+
+/* Returns T's save area, aligned within its buffer. */
+static uint8_t *
+state_of (struct thread *t) {
+	return (uint8_t *) ROUND_UP ((uintptr_t) t->fpu_buf, STATE_ALIGN);
+}
+
+/* Returns a buffer for a save area, or a null pointer if memory runs
+   out. */
+static void *
+alloc_state (void) {
+	return malloc (state_size + STATE_ALIGN - 1);
+}
+
+/* Saves the FPU registers to T's save area.  CR0.TS must be clear. */
+static void
+save (struct thread *t) {
+	if (use_xsave)
+		asm volatile ("xsave64 (%0)"
+				: : "r" (state_of (t)), "a" ((uint32_t) xstate_mask),
+				"d" ((uint32_t) (xstate_mask >> 32)) : "memory");
+	else
+		asm volatile ("fxsave64 (%0)" : : "r" (state_of (t)) : "memory");
+}
+
+/* Loads the FPU registers from T's save area.  CR0.TS must be
+   clear. */
+static void
+restore (struct thread *t) {
+	if (use_xsave)
+		asm volatile ("xrstor64 (%0)"
+				: : "r" (state_of (t)), "a" ((uint32_t) xstate_mask),
+				"d" ((uint32_t) (xstate_mask >> 32)) : "memory");
+	else
+		asm volatile ("fxrstor64 (%0)" : : "r" (state_of (t)) : "memory");
+}
+
+/* Sets CR0.TS if SET is true, and clears it otherwise. */
+static void
+set_ts (bool set) {
+	if (set == ts_set)
+		return;
+	if (set)
+		lcr0 (rcr0 () | CR0_TS);
+	else
+		clts ();
+	ts_set = set;
+}
+
+/* Enables the FPU, SSE and, if the CPU has it, XSAVE, and arranges for
+   the first FPU instruction to trap. */
+void
+fpu_init (void) {
+	uint32_t regs[4];
+
+	lcr0 ((rcr0 () & ~CR0_EM) | CR0_MP | CR0_NE | CR0_TS);
+	ts_set = true;
+	lcr4 (rcr4 () | CR4_OSFXSR | CR4_OSXMMEXCPT);
+
+	state_size = FXSAVE_SIZE;
+	cpuid (1, 0, regs);
+	if (regs[2] & CPUID_XSAVE) {
+		lcr4 (rcr4 () | CR4_OSXSAVE);
+		cpuid (0xd, 0, regs);
+		xstate_mask = (((uint64_t) regs[3] << 32) | regs[0])
+			& (XSTATE_X87 | XSTATE_SSE | XSTATE_AVX);
+		xsetbv (0, xstate_mask);
+
+		/* EBX is the size of the components now enabled. */
+		cpuid (0xd, 0, regs);
+		state_size = regs[1];
+		use_xsave = true;
+	}
+
+	/* An all-zero XSAVE header marks every component as in its
+	   initial state, except that MXCSR is always loaded. */
+	init_state = alloc_state ();
+	if (init_state == NULL)
+		PANIC ("fpu_init: out of memory");
+	init_state = (uint8_t *) ROUND_UP ((uintptr_t) init_state, STATE_ALIGN);
+	memset (init_state, 0, state_size);
+	*(uint16_t *) (init_state + FCW_OFS) = FCW_INIT;
+	*(uint32_t *) (init_state + MXCSR_OFS) = MXCSR_INIT;
+
+	intr_register_int (7, 0, INTR_ON, fpu_trap,
+			"#NM Device Not Available Exception");
+}
+
+/* Called by schedule(), with interrupts off, before switching to NEXT.
+   Lets NEXT use the FPU directly if its state is loaded. */
+void
+fpu_switch (struct thread *next) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	set_ts (next != fpu_owner);
+}
+
+/* #NM handler: loads the current thread's FPU state, giving it one
+   first if it has never used the FPU. */
+static void
+fpu_trap (struct intr_frame *f) {
+	struct thread *t = thread_current ();
+	enum intr_level old_level;
+
+	if (f->cs != SEL_UCSEG)
+		PANIC ("Kernel used the FPU at %p", (void *) f->rip);
+
+	if (t->fpu_buf == NULL) {
+		t->fpu_buf = alloc_state ();
+		if (t->fpu_buf == NULL) {
+#ifdef USERPROG
+			exit (-1);
+#else
+			PANIC ("%s: out of memory for FPU state", t->name);
+#endif
+		}
+		memcpy (state_of (t), init_state, state_size);
+	}
+
+	old_level = intr_disable ();
+	set_ts (false);
+	if (fpu_owner != t) {
+		if (fpu_owner != NULL)
+			save (fpu_owner);
+		restore (t);
+		fpu_owner = t;
+		restore_cnt++;
+	}
+	intr_set_level (old_level);
+}
+
+/* Gives the current thread, a child being forked, a copy of the FPU
+   state of SRC, its parent.  Returns false if memory runs out. */
+bool
+fpu_copy (struct thread *src) {
+	struct thread *t = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (t->fpu_buf == NULL);
+	if (src->fpu_buf == NULL)
+		return true;
+	t->fpu_buf = alloc_state ();
+	if (t->fpu_buf == NULL)
+		return false;
+
+	/* The registers may be newer than SRC's save area. */
+	old_level = intr_disable ();
+	if (fpu_owner == src) {
+		set_ts (false);
+		save (src);
+		set_ts (true);
+	}
+	memcpy (state_of (t), state_of (src), state_size);
+	intr_set_level (old_level);
+	return true;
+}
+
+/* Drops the current thread's FPU state, for exec() or exit.  It
+   starts over from the initial state if it uses the FPU again. */
+void
+fpu_reset (void) {
+	struct thread *t = thread_current ();
+	enum intr_level old_level = intr_disable ();
+
+	if (fpu_owner == t) {
+		fpu_owner = NULL;
+		set_ts (true);
+	}
+	intr_set_level (old_level);
+	free (t->fpu_buf);
+	t->fpu_buf = NULL;
+}
+
+/* Prints FPU statistics. */
+void
+fpu_print_stats (void) {
+	printf ("FPU: %lld lazy restores\n", restore_cnt);
+}
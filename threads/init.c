@@ -13,14 +13,17 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "devices/vga.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
+#include "threads/profile.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -46,6 +49,12 @@ uint64_t *base_pml4;
 static bool format_filesys;
 #endif
 
+/* -trace: Record kernel events for utils/trace2json? */
+static bool trace_events;
+
+/* -profile: Samples per second to profile at, or 0. */
+static int profile_hz;
+
 /* -q: Power off after kernel tasks complete? */
 bool power_off_when_done;
 
@@ -86,6 +95,8 @@ main (void) {
 	mem_end = palloc_init ();
 	malloc_init ();
 	paging_init (mem_end);
+	if (trace_events)
+		trace_init ();
 
 #ifdef USERPROG
 	tss_init ();
@@ -94,7 +105,10 @@ main (void) {
 
 	/* Initialize interrupt handlers. */
 	intr_init ();
+	fpu_init ();
 	timer_init ();
+	if (profile_hz != 0)
+		profile_init (profile_hz);
 	kbd_init ();
 	input_init ();
 #ifdef USERPROG
@@ -142,7 +156,10 @@ bss_init (void) {
 
 /* Populates the page table with the kernel virtual mapping,
  * and then sets up the CPU to use the new page directory.
- * Points base_pml4 to the pml4 it creates. */
+ * Points base_pml4 to the pml4 it creates.
+ * Memory is mapped with 2 MB pages wherever a whole aligned 2 MB
+ * lies below MEM_END and holds no kernel text, which has to stay
+ * read-only at 4 kB granularity. */
 static void
 paging_init (uint64_t mem_end) {
 	uint64_t *pml4, *pte;
@@ -150,21 +167,33 @@ paging_init (uint64_t mem_end) {
 	pml4 = base_pml4 = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 
 	extern char start, _end_kernel_text;
+	uint64_t text_start = (uint64_t) &start;
+	uint64_t text_end = (uint64_t) &_end_kernel_text;
 	// Maps physical address [0 ~ mem_end] to
 	//   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
-	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
+	for (uint64_t pa = 0; pa < mem_end; ) {
 		uint64_t va = (uint64_t) ptov(pa);
 
+		if (pa % HPGSIZE == 0 && pa + HPGSIZE <= mem_end
+				&& (va + HPGSIZE <= text_start || va >= text_end)) {
+			if ((pte = pml4e_walk_pde (pml4, va, 1)) != NULL)
+				*pte = pa | PTE_P | PTE_W | PTE_PS;
+			pa += HPGSIZE;
+			continue;
+		}
+
 		perm = PTE_P | PTE_W;
-		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
+		if (text_start <= va && va < text_end)
 			perm &= ~PTE_W;
 
 		if ((pte = pml4e_walk (pml4, va, 1)) != NULL)
 			*pte = pa | perm;
+		pa += PGSIZE;
 	}
 
 	// reload cr3
 	pml4_activate(0);
+	pcid_init ();
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -221,11 +250,22 @@ parse_options (char **argv) {
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-trace"))
+			trace_events = true;
+		else if (!strcmp (name, "-profile")) {
+			profile_hz = value != NULL ? atoi (value) : TIMER_FREQ;
+			if (profile_hz < 1 || profile_hz > 10000)
+				PANIC ("-profile rate must be between 1 and 10000 Hz");
+		}
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-sl"))
+			stack_page_limit = atoi (value);
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -326,8 +366,13 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -trace             Trace kernel events for utils/trace2json.\n"
+			"  -profile[=HZ]      Profile the kernel, HZ samples a second.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -sl=COUNT          Limit user stacks to COUNT pages.\n"
 #endif
 			);
 	power_off ();
@@ -338,6 +383,7 @@ usage (void) {
    as long as we're running on Bochs or QEMU. */
 void
 power_off (void) {
+	trace_dump ();
 #ifdef FILESYS
 	filesys_done ();
 #endif
@@ -354,12 +400,22 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	fpu_print_stats ();
+#ifdef USERPROG
+	syscall_print_stats ();
+#endif
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
 	console_print_stats ();
 	kbd_print_stats ();
+	intr_print_stats ();
 #ifdef USERPROG
 	exception_print_stats ();
+	pcid_print_stats ();
+#endif
+#ifdef VM
+	vm_print_stats ();
 #endif
+	profile_print ();
 }
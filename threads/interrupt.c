@@ -4,9 +4,11 @@
 #include <stdint.h>
 #include <stdio.h>
 #include "threads/flags.h"
+#include "threads/init.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #include "threads/mmu.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
@@ -103,10 +105,30 @@ static const char *intr_names[INTR_CNT];
 static bool in_external_intr;   /* Are we processing an external interrupt? */
 static bool yield_on_return;    /* Should we yield on interrupt return? */
 
+/* Accounting.  STATS counts each vector and the cycles spent in
+   its handler.  OFF_STATS times the spans with interrupts off that
+   start with intr_disable() or intr_set_level() turning them off
+   and end with intr_enable() or intr_set_level() turning them back
+   on, possibly in another thread after a switch.  Spans that end
+   some other way, in `sti; hlt' in the idle thread or in `iretq'
+   back to an interrupted thread, are not counted: the next
+   interrupt of code running with interrupts on forgets them. */
+static struct intrstat stats[INTR_CNT];
+static struct intrstat off_stats;
+static void *off_site;          /* Where the current span started, or null. */
+static uint64_t off_since;      /* TSC when it started. */
+
+static enum intr_level disable (void *site);
+static enum intr_level enable (void);
+
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
 static void pic_end_of_interrupt (int irq);
 
+/* Local APIC helpers. */
+static void lapic_init (void);
+static void lapic_end_of_interrupt (void);
+
 /* Interrupt handlers. */
 void intr_handler (struct intr_frame *args);
 
@@ -128,15 +150,40 @@ intr_get_level (void) {
    returns the previous interrupt status. */
 enum intr_level
 intr_set_level (enum intr_level level) {
-	return level == INTR_ON ? intr_enable () : intr_disable ();
+	return level == INTR_ON ? enable () : disable (__builtin_return_address (0));
 }
 
 /* Enables interrupts and returns the previous interrupt status. */
 enum intr_level
 intr_enable (void) {
+	return enable ();
+}
+
+/* Disables interrupts and returns the previous interrupt status. */
+enum intr_level
+intr_disable (void) {
+	return disable (__builtin_return_address (0));
+}
+
+/* Enables interrupts and returns the previous interrupt status,
+   ending the span they were off for. */
+static enum intr_level
+enable (void) {
 	enum intr_level old_level = intr_get_level ();
 	ASSERT (!intr_context ());
 
+	if (old_level == INTR_OFF && off_site != NULL) {
+		uint64_t cycles = rdtsc () - off_since;
+
+		off_stats.count++;
+		off_stats.cycles += cycles;
+		if (cycles > off_stats.max_cycles) {
+			off_stats.max_cycles = cycles;
+			off_stats.max_site = (uint64_t) off_site;
+		}
+		off_site = NULL;
+	}
+
 	/* Enable interrupts by setting the interrupt flag.
 
 	   See [IA32-v2b] "STI" and [IA32-v3a] 5.8.1 "Masking Maskable
@@ -146,9 +193,10 @@ intr_enable (void) {
 	return old_level;
 }
 
-/* Disables interrupts and returns the previous interrupt status. */
-enum intr_level
-intr_disable (void) {
+/* Disables interrupts and returns the previous interrupt status.
+   If they were on, starts a span with them off, blamed on SITE. */
+static enum intr_level
+disable (void *site) {
 	enum intr_level old_level = intr_get_level ();
 
 	/* Disable interrupts by clearing the interrupt flag.
@@ -156,6 +204,10 @@ intr_disable (void) {
 	   Hardware Interrupts". */
 	asm volatile ("cli" : : : "memory");
 
+	if (old_level == INTR_ON) {
+		off_since = rdtsc ();
+		off_site = site;
+	}
 	return old_level;
 }
 
@@ -164,8 +216,9 @@ void
 intr_init (void) {
 	int i;
 
-	/* Initialize interrupt controller. */
+	/* Initialize interrupt controllers. */
 	pic_init ();
+	lapic_init ();
 
 	/* Initialize IDT. */
 	for (i = 0; i < INTR_CNT; i++) {
@@ -227,7 +280,7 @@ register_handler (uint8_t vec_no, int dpl, enum intr_level level,
 void
 intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
 		const char *name) {
-	ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+	ASSERT (vec_no >= 0x20 && vec_no <= 0x3f);
 	register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
@@ -248,7 +301,7 @@ void
 intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
 		intr_handler_func *handler, const char *name)
 {
-	ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+	ASSERT (vec_no < 0x20 || vec_no > 0x3f);
 	register_handler (vec_no, dpl, level, handler, name);
 }
 
@@ -322,6 +375,104 @@ pic_end_of_interrupt (int irq) {
 	if (irq >= 0x28)
 		outb (0xa0, 0x20);
 }
+
+/* Local APIC.
+
+   Besides the PICs, the CPU has a local APIC, which has a timer of
+   its own that devices/timer.c prefers over the 8254 because it can
+   be programmed for a single interrupt at an arbitrary time.  The
+   PICs stay in charge of the devices: the local APIC passes their
+   interrupts through on its LINT0 pin ("virtual wire" mode).  The
+   local APIC's own interrupts use vectors 0x30...0x3f.  They are
+   external interrupts like the PICs' but acknowledged on the local
+   APIC instead. */
+
+#define MSR_APIC_BASE 0x1b          /* IA32_APIC_BASE MSR. */
+#define APIC_BASE_ENABLE 0x800      /* Global enable bit in MSR_APIC_BASE. */
+#define CPUID_APIC (1U << 9)        /* CPUID.1:EDX: local APIC present. */
+
+/* Local APIC registers, by byte offset, and their bits. */
+#define LAPIC_TPR 0x080             /* Task priority. */
+#define LAPIC_EOI 0x0b0             /* End of interrupt. */
+#define LAPIC_SVR 0x0f0             /* Spurious interrupt vector. */
+#define LAPIC_SVR_ENABLE 0x100      /* Software enable. */
+#define LAPIC_LINT0 0x350           /* Local vector table: LINT0 pin. */
+#define LAPIC_LINT1 0x360           /* Local vector table: LINT1 pin. */
+#define LAPIC_DM_NMI 0x400          /* Deliver as NMI. */
+#define LAPIC_DM_EXTINT 0x700       /* Deliver as if from a PIC. */
+
+/* Vector of spurious local APIC interrupts.  The low 4 bits must be
+   set on older CPUs. */
+#define LAPIC_SPURIOUS 0xff
+
+/* Local APIC registers, or a null pointer if there is no local APIC. */
+static volatile uint32_t *lapic;
+
+/* Spurious local APIC interrupt handler.  These need no EOI. */
+static void
+lapic_spurious (struct intr_frame *f UNUSED) {
+}
+
+/* Maps the local APIC's registers and enables it, if the CPU has
+   one. */
+static void
+lapic_init (void) {
+	uint32_t regs[4];
+	uint64_t base, *pte;
+	void *va;
+
+	cpuid (1, 0, regs);
+	if (!(regs[3] & CPUID_APIC))
+		return;
+	base = read_msr (MSR_APIC_BASE);
+	write_msr (MSR_APIC_BASE, base | APIC_BASE_ENABLE);
+
+	/* Map the registers, uncached, where the direct map would have
+	   them if it went that high.  Every page table shares the
+	   mapping since it sits among the kernel's. */
+	base = PTE_ADDR (base) & 0xffffffffffULL;
+	va = ptov (base);
+	pte = pml4e_walk (base_pml4, (uint64_t) va, 1);
+	if (pte == NULL)
+		return;
+	if (!(*pte & PTE_P))
+		*pte = base | PTE_P | PTE_W | PTE_PCD | PTE_PWT;
+	invlpg ((uint64_t) va);
+	lapic = va;
+
+	lapic_write (LAPIC_TPR, 0);
+	lapic_write (LAPIC_LINT0, LAPIC_DM_EXTINT);
+	lapic_write (LAPIC_LINT1, LAPIC_DM_NMI);
+	lapic_write (LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS);
+	intr_register_int (LAPIC_SPURIOUS, 0, INTR_OFF, lapic_spurious,
+			"Local APIC spurious");
+}
+
+/* Returns true if the CPU has a local APIC, which is then enabled. */
+bool
+lapic_present (void) {
+	return lapic != NULL;
+}
+
+/* Returns the value of the local APIC register at byte offset REG. */
+uint32_t
+lapic_read (unsigned reg) {
+	ASSERT (lapic != NULL);
+	return lapic[reg / sizeof *lapic];
+}
+
+/* Sets the local APIC register at byte offset REG to VALUE. */
+void
+lapic_write (unsigned reg, uint32_t value) {
+	ASSERT (lapic != NULL);
+	lapic[reg / sizeof *lapic] = value;
+}
+
+/* Signals the end of the local APIC interrupt being handled. */
+static void
+lapic_end_of_interrupt (void) {
+	lapic_write (LAPIC_EOI, 0);
+}
 /* Interrupt handlers. */
 
 /* Handler for all interrupts, faults, and exceptions.  This
@@ -330,14 +481,16 @@ pic_end_of_interrupt (int irq) {
    interrupted thread's registers. */
 void
 intr_handler (struct intr_frame *frame) {
+	struct intrstat *st = &stats[frame->vec_no];
+	uint64_t start = rdtsc (), cycles;
 	bool external;
 	intr_handler_func *handler;
 
 	/* External interrupts are special.
 	   We only handle one at a time (so interrupts must be off)
-	   and they need to be acknowledged on the PIC (see below).
-	   An external interrupt handler cannot sleep. */
-	external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+	   and they need to be acknowledged on the PIC or local APIC
+	   (see below).  An external interrupt handler cannot sleep. */
+	external = frame->vec_no >= 0x20 && frame->vec_no < 0x40;
 	if (external) {
 		ASSERT (intr_get_level () == INTR_OFF);
 		ASSERT (!intr_context ());
@@ -346,7 +499,16 @@ intr_handler (struct intr_frame *frame) {
 		yield_on_return = false;
 	}
 
+	/* If interrupts were on, any span we were timing ended
+	   we know not when. */
+	if (frame->eflags & FLAG_IF)
+		off_site = NULL;
+
+	/* Count first: some handlers never return. */
+	st->count++;
+
 	/* Invoke the interrupt's handler. */
+	TRACE (TRACE_INTR_ENTER, frame->vec_no, frame->rip);
 	handler = intr_handlers[frame->vec_no];
 	if (handler != NULL)
 		handler (frame);
@@ -360,6 +522,11 @@ intr_handler (struct intr_frame *frame) {
 		intr_dump_frame (frame);
 		PANIC ("Unexpected interrupt");
 	}
+	TRACE (TRACE_INTR_EXIT, frame->vec_no, 0);
+	cycles = rdtsc () - start;
+	st->cycles += cycles;
+	if (cycles > st->max_cycles)
+		st->max_cycles = cycles;
 
 	/* Complete the processing of an external interrupt. */
 	if (external) {
@@ -367,11 +534,62 @@ intr_handler (struct intr_frame *frame) {
 		ASSERT (intr_context ());
 
 		in_external_intr = false;
-		pic_end_of_interrupt (frame->vec_no);
+		if (frame->vec_no < 0x30)
+			pic_end_of_interrupt (frame->vec_no);
+		else
+			lapic_end_of_interrupt ();
 
-		if (yield_on_return)
+		if (yield_on_return) {
 			thread_yield ();
+
+			/* About to return to this thread with interrupts on,
+			   ending any span that another thread started. */
+			off_site = NULL;
+		}
+	}
+}
+
+/* Copies the accounting for vector VEC, or for interrupts-off
+   spans if VEC is INTRSTAT_OFF, into *ST.  Returns false if VEC is
+   neither. */
+bool
+intr_get_stats (int vec, struct intrstat *st) {
+	enum intr_level old_level;
+
+	if (vec != INTRSTAT_OFF && (vec < 0 || vec >= INTR_CNT))
+		return false;
+
+	/* Handlers update these with interrupts off. */
+	old_level = intr_disable ();
+	*st = vec == INTRSTAT_OFF ? off_stats : stats[vec];
+	intr_set_level (old_level);
+	return true;
+}
+
+/* Prints interrupt statistics: each vector that has been taken,
+   then the spans with interrupts off. */
+void
+intr_print_stats (void) {
+	struct intrstat off;
+	int i;
+
+	for (i = 0; i < INTR_CNT; i++) {
+		const struct intrstat *st = &stats[i];
+
+		if (st->count == 0)
+			continue;
+		printf ("Interrupt %#04x (%s): %"PRId64" taken, "
+				"%"PRIu64" cycles avg, %"PRIu64" max\n",
+				i, intr_names[i], st->count,
+				st->cycles / st->count, st->max_cycles);
 	}
+
+	intr_get_stats (INTRSTAT_OFF, &off);
+	if (off.count > 0)
+		printf ("Interrupts off: %"PRId64" times, %"PRIu64" cycles avg, "
+				"%"PRIu64" max from %#"PRIx64"\n",
+				off.count, off.cycles / off.count, off.max_cycles,
+				off.max_site);
 }
 
 /* Dumps interrupt frame F to the console, for debugging. */
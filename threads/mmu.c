@@ -1,5 +1,6 @@
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
 #include "threads/pte.h"
@@ -8,11 +9,16 @@
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+static void pcid_release (uint64_t *pml4);
+
 static uint64_t *
 pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 	int idx = PDX (va);
 	if (pdp) {
 		uint64_t *pte = (uint64_t *) pdp[idx];
+		/* A 2 MB page has no page table; its PDE is the entry. */
+		if ((uint64_t) pte & PTE_P && (uint64_t) pte & PTE_PS)
+			return &pdp[idx];
 		if (!((uint64_t) pte & PTE_P)) {
 			if (create) {
 				uint64_t *new_page = palloc_get_page (PAL_ZERO);
@@ -60,7 +66,9 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
  * If PML4E does not have a page table for VADDR, behavior depends
  * on CREATE.  If CREATE is true, then a new page table is
  * created and a pointer into it is returned.  Otherwise, a null
- * pointer is returned. */
+ * pointer is returned.
+ * If VADDR lies in a 2 MB page, the page directory entry that maps
+ * it is returned instead; see is_huge_pte(). */
 uint64_t *
 pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	uint64_t *pte = NULL;
@@ -88,6 +96,28 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	return pte;
 }
 
+/* Returns the address of the page directory entry for virtual
+ * address VA in PML4, for mapping a 2 MB page.  Missing page
+ * directory pointer tables and page directories are created if
+ * CREATE is true; otherwise a null pointer is returned. */
+uint64_t *
+pml4e_walk_pde (uint64_t *pml4, const uint64_t va, int create) {
+	uint64_t *table = pml4;
+	uint64_t shift;
+
+	for (shift = PML4SHIFT; shift > PDXSHIFT; shift -= 9) {
+		uint64_t *e = &table[(va >> shift) & 0x1FF];
+		if (!(*e & PTE_P)) {
+			uint64_t *new_page = create ? palloc_get_page (PAL_ZERO) : NULL;
+			if (new_page == NULL)
+				return NULL;
+			*e = vtop (new_page) | PTE_U | PTE_W | PTE_P;
+		}
+		table = ptov (PTE_ADDR (*e));
+	}
+	return &table[PDX (va)];
+}
+
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
@@ -96,7 +126,7 @@ uint64_t *
 pml4_create (void) {
 	uint64_t *pml4 = palloc_get_page (0);
 	if (pml4)
-		memcpy (pml4, base_pml4, PGSIZE);
+		copy_page (pml4, base_pml4);
 	return pml4;
 }
 
@@ -122,10 +152,17 @@ pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
-			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
-					pml4_index, pdp_index, i))
+		if (!(((uint64_t) pte) & PTE_P))
+			continue;
+		if (((uint64_t) pte) & PTE_PS) {
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) pdp_index << PDPESHIFT) |
+								 ((uint64_t) i << PDXSHIFT));
+			if (!func (&pdp[i], va, aux))
 				return false;
+		} else if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
+					pml4_index, pdp_index, i))
+			return false;
 	}
 	return true;
 }
@@ -143,7 +180,8 @@ pdp_for_each (uint64_t *pdp,
 	return true;
 }
 
-/* Apply FUNC to each available pte entries including kernel's. */
+/* Apply FUNC to each available pte entries including kernel's.
+ * A 2 MB page is visited once, with its page directory entry. */
 bool
 pml4_for_each (uint64_t *pml4, pte_for_each_func *func, void *aux) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
@@ -196,16 +234,139 @@ pml4_destroy (uint64_t *pml4) {
 	uint64_t *pdpe = ptov ((uint64_t *) pml4[0]);
 	if (((uint64_t) pdpe) & PTE_P)
 		pdpe_destroy ((void *) PTE_ADDR (pdpe));
+	pcid_release (pml4);
 	palloc_free_page ((void *) pml4);
 }
 
 /* Loads page directory PD into the CPU's page directory base
- * register. */
+ * register.  The translations cached under PCID 0 are flushed. */
 void
 pml4_activate (uint64_t *pml4) {
 	lcr3 (vtop (pml4 ? pml4 : base_pml4));
 }
 
+/* Process-context identifiers.
+ *
+ * With CR4.PCIDE set, the TLB tags every translation with the PCID
+ * held in the low 12 bits of CR3, so translations of several address
+ * spaces can stay cached side by side and loading CR3 with
+ * CR3_NOFLUSH set does not drop them.  PCID 0 belongs to base_pml4
+ * and untagged activations; PCIDs 1...PCID_CNT - 1 are handed out to
+ * user address spaces in order.  When they run out, the generation
+ * counter is bumped, which invalidates every tag at once.  A PCID is
+ * flushed when it is handed out, so reuse never sees stale entries.
+ *
+ * pcid_owner[] records which pml4 holds each PCID in the current
+ * generation.  A tag is only trusted if it still names its owner;
+ * clearing an owner forces the next activation to take a fresh,
+ * flushed PCID.  That is how pml4_destroy() and changes to PTEs of a
+ * pml4 that is not loaded (where invlpg cannot reach) retire the
+ * translations cached for it.
+ *
+ * The way back, from a pml4 to its PCID, is kept in the pml4 itself,
+ * in entry PCID_SLOT.  That entry maps the top 512 GB of the address
+ * space, which neither user programs nor the kernel use, and the CPU
+ * ignores every bit of an entry whose PTE_P is clear.  The PCID is
+ * stored shifted left by one, so PTE_P stays clear.  An entry left
+ * over from an earlier generation is harmless: its PCID no longer
+ * names this pml4 as owner. */
+#define CR4_PCIDE (1UL << 17)           /* CR4: enable PCIDs. */
+#define CR3_NOFLUSH (1UL << 63)         /* CR3: keep the PCID's entries. */
+#define CPUID_PCID (1U << 17)           /* CPUID.1:ECX: PCID supported. */
+#define PCID_CNT 4096                   /* Number of PCIDs. */
+#define PCID_SLOT (PGSIZE / sizeof (uint64_t) - 1)  /* PML4 entry. */
+
+static bool pcid_enabled;
+static uint64_t *pcid_owner[PCID_CNT];  /* Owner of each PCID. */
+static uint16_t pcid_next;              /* Next PCID to hand out. */
+static uint64_t pcid_gen;               /* Current generation. */
+static long long pcid_assign_cnt;       /* # of PCIDs handed out. */
+static long long pcid_reuse_cnt;        /* # of switches w/o flush. */
+
+/* Enables PCIDs if the CPU supports them.  Must be called with
+ * base_pml4 loaded under PCID 0. */
+void
+pcid_init (void) {
+	uint32_t regs[4];
+
+	cpuid (1, 0, regs);
+	if (!(regs[2] & CPUID_PCID))
+		return;
+	ASSERT ((rcr3 () & PTE_FLAGS) == 0);
+	ASSERT (base_pml4[PCID_SLOT] == 0);
+	lcr4 (rcr4 () | CR4_PCIDE);
+	pcid_enabled = true;
+	pcid_next = 1;
+	pcid_gen = 1;
+}
+
+/* Retires the PCID currently owned by PML4, if any. */
+static void
+pcid_release (uint64_t *pml4) {
+	uint64_t pcid = pml4[PCID_SLOT] >> 1;
+
+	if (pcid_enabled && pcid != 0 && pcid_owner[pcid] == pml4)
+		pcid_owner[pcid] = NULL;
+}
+
+/* Loads PML4 into CR3 under the PCID recorded in TAG.  If TAG is
+ * still valid the address space's cached translations are kept,
+ * otherwise a new PCID is assigned to it and flushed.  Falls back to
+ * pml4_activate() without PCID support or for a null PML4. */
+void
+pml4_activate_tagged (uint64_t *pml4, struct pcid_tag *tag) {
+	if (!pcid_enabled || pml4 == NULL) {
+		pml4_activate (pml4);
+		return;
+	}
+
+	if (tag->gen == pcid_gen && pcid_owner[tag->pcid] == pml4) {
+		pcid_reuse_cnt++;
+		lcr3 (vtop (pml4) | tag->pcid | CR3_NOFLUSH);
+		return;
+	}
+
+	if (pcid_next == PCID_CNT) {
+		/* Out of PCIDs: start a new generation.  Every PCID gets
+		 * flushed again when it is handed out. */
+		memset (pcid_owner, 0, sizeof pcid_owner);
+		pcid_next = 1;
+		pcid_gen++;
+	}
+	tag->pcid = pcid_next++;
+	tag->gen = pcid_gen;
+	pcid_owner[tag->pcid] = pml4;
+	pml4[PCID_SLOT] = (uint64_t) tag->pcid << 1;
+	pcid_assign_cnt++;
+	lcr3 (vtop (pml4) | tag->pcid);
+}
+
+/* Prints PCID statistics. */
+void
+pcid_print_stats (void) {
+	if (pcid_enabled)
+		printf ("PCID: %lld assigned, %lld switches without flush, "
+				"%llu generations\n",
+				pcid_assign_cnt, pcid_reuse_cnt, pcid_gen);
+}
+
+/* Returns true if PML4 is the page table the CPU is using. */
+static bool
+pml4_is_active (uint64_t *pml4) {
+	return PTE_ADDR (rcr3 ()) == vtop (pml4);
+}
+
+/* Drops the TLB entry for VA in PML4 after its PTE changed.  The
+ * loaded address space is fixed up with invlpg, which acts on the
+ * current PCID only; any other gives up its PCID instead. */
+static void
+pml4_invalidate (uint64_t *pml4, const void *va) {
+	if (pml4_is_active (pml4))
+		invlpg ((uint64_t) va);
+	else
+		pcid_release (pml4);
+}
+
 /* Looks up the physical address that corresponds to user virtual
  * address UADDR in pml4.  Returns the kernel virtual address
  * corresponding to that physical address, or a null pointer if
@@ -216,8 +377,11 @@ pml4_get_page (uint64_t *pml4, const void *uaddr) {
 
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
 
-	if (pte && (*pte & PTE_P))
+	if (pte && (*pte & PTE_P)) {
+		if (is_huge_pte (pte))
+			return ptov (HPTE_ADDR (*pte)) + ((uint64_t) uaddr & (HPGSIZE - 1));
 		return ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
+	}
 	return NULL;
 }
 
@@ -257,8 +421,7 @@ pml4_clear_page (uint64_t *pml4, void *upage) {
 
 	if (pte != NULL && (*pte & PTE_P) != 0) {
 		*pte &= ~PTE_P;
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) upage);
+		pml4_invalidate (pml4, upage);
 	}
 }
 
@@ -273,18 +436,19 @@ pml4_is_dirty (uint64_t *pml4, const void *vpage) {
 }
 
 /* Set the dirty bit to DIRTY in the PTE for virtual page VPAGE
- * in PML4. */
+ * in PML4.  Only clearing the bit needs the TLB entry dropped: a
+ * cached entry without PTE_D just makes the CPU set it again, and
+ * keeping the PCID spares the next switch a flush. */
 void
 pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
 	if (pte) {
 		if (dirty)
 			*pte |= PTE_D;
-		else
+		else {
 			*pte &= ~(uint32_t) PTE_D;
-
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+			pml4_invalidate (pml4, vpage);
+		}
 	}
 }
 
@@ -299,17 +463,17 @@ pml4_is_accessed (uint64_t *pml4, const void *vpage) {
 }
 
 /* Sets the accessed bit to ACCESSED in the PTE for virtual page
-   VPAGE in PD. */
+   VPAGE in PD.  As with pml4_set_dirty(), only clearing it
+   invalidates. */
 void
 pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
 	if (pte) {
 		if (accessed)
 			*pte |= PTE_A;
-		else
+		else {
 			*pte &= ~(uint32_t) PTE_A;
-
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+			pml4_invalidate (pml4, vpage);
+		}
 	}
 }
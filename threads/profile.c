@@ -0,0 +1,181 @@
+#include "threads/profile.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Sampling profiler.
+ *
+ * With -profile on the kernel command line, each timer tick takes a
+ * sample of what the CPU was doing when the tick came: the rip in
+ * the interrupt frame, and, if it was running kernel code, the
+ * return addresses found by following the chain of saved frame
+ * pointers up the interrupted thread's stack.  The kernel is built
+ * with -fno-omit-frame-pointer, so the chain is there to follow.
+ * Samples taken in user mode all count as one "user" stack.
+ *
+ * -profile=HZ samples HZ times a second instead.  The CPU has just
+ * the one local APIC timer, which is busy scheduling, so these
+ * samples come from the 8254 PIT, which has nothing else to do once
+ * the local APIC drives the timer.  Without a local APIC, the PIT
+ * is the timer and sampling stays at TIMER_FREQ.
+ *
+ * The local APIC timer is one-shot and also fires at sleepers'
+ * deadlines between ticks, or late, after several ticks have gone
+ * by.  Sampling on ticks therefore takes a sample only on interrupts
+ * that run ticks, and counts it once per tick run, so that the
+ * profile still weighs what the CPU did at TIMER_FREQ.
+ *
+ * Identical stacks are counted together in an open-addressed table
+ * that is allocated at boot, so taking a sample allocates nothing.
+ * At power off the table is printed on the console, a line per
+ * distinct stack, for utils/profile to symbolize against kernel.o
+ * into a flat profile and folded stacks for flame graphs. */
+
+/* Most frames recorded per sample, innermost first. */
+#define PROFILE_DEPTH 16
+
+/* Pages in the table of distinct stacks. */
+#define PROFILE_PAGES 128
+
+/* A distinct stack and how many samples found it. */
+struct stack {
+	uint64_t count;             /* Samples; 0 if the slot is free. */
+	int depth;                  /* Frames in PCS. */
+	uintptr_t pcs[PROFILE_DEPTH];   /* Innermost first; 0 is user. */
+};
+
+#define STACK_CNT (PROFILE_PAGES * PGSIZE / sizeof (struct stack))
+
+/* Probes before giving up on finding a slot. */
+#define MAX_PROBES 32
+
+static struct stack *stacks;    /* Table of STACK_CNT stacks. */
+static bool profiling;          /* Taking samples? */
+static bool on_ticks;           /* Sampling on timer ticks? */
+static int sample_hz;           /* Samples per second. */
+static uint64_t sample_cnt;     /* Samples taken. */
+static uint64_t lost_cnt;       /* Samples with no room in STACKS. */
+
+static intr_handler_func sampler_interrupt;
+static void sample (const struct intr_frame *, int weight);
+
+/* Starts sampling HZ times a second, or on each timer tick if HZ is
+   TIMER_FREQ or less. */
+void
+profile_init (int hz) {
+	stacks = palloc_get_multiple (PAL_ZERO, PROFILE_PAGES);
+	if (stacks == NULL) {
+		printf ("profile: no memory for %d-page table\n", PROFILE_PAGES);
+		return;
+	}
+
+	if (hz > TIMER_FREQ && timer_start_sampler (hz, sampler_interrupt))
+		sample_hz = hz;
+	else {
+		on_ticks = true;
+		sample_hz = TIMER_FREQ;
+	}
+	profiling = true;
+}
+
+/* Called by the timer interrupt handler with its frame F, having
+   run TICK_CNT timer ticks. */
+void
+profile_tick (const struct intr_frame *f, int tick_cnt) {
+	if (on_ticks && profiling && tick_cnt > 0)
+		sample (f, tick_cnt);
+}
+
+/* Interrupt handler for the PIT when it is used for sampling. */
+static void
+sampler_interrupt (struct intr_frame *f) {
+	if (profiling)
+		sample (f, 1);
+}
+
+/* Follows the frame pointers from F, which interrupted kernel code,
+   storing return addresses after F's rip in PCS.  Returns the number
+   of addresses stored. */
+static int
+walk_stack (const struct intr_frame *f, uintptr_t pcs[PROFILE_DEPTH]) {
+	/* A kernel thread's stack lies within the page holding its
+	   struct thread, and saved frame pointers only ever point
+	   further up it. */
+	uintptr_t bottom = f->rsp;
+	uintptr_t top = (uintptr_t) pg_round_down (f->rsp) + PGSIZE;
+	uintptr_t *frame = (uintptr_t *) f->R.rbp;
+	int depth = 0;
+
+	pcs[depth++] = f->rip;
+	while (depth < PROFILE_DEPTH
+			&& (uintptr_t) frame >= bottom
+			&& (uintptr_t) (frame + 2) <= top
+			&& (uintptr_t) frame % sizeof *frame == 0
+			&& frame[1] != 0) {
+		pcs[depth++] = frame[1];
+		bottom = (uintptr_t) (frame + 2);
+		frame = (uintptr_t *) frame[0];
+	}
+	return depth;
+}
+
+/* Counts a sample of what F interrupted, WEIGHT times. */
+static void
+sample (const struct intr_frame *f, int weight) {
+	struct stack s;
+	size_t i, probe;
+
+	memset (&s, 0, sizeof s);
+	if (f->cs == SEL_KCSEG)
+		s.depth = walk_stack (f, s.pcs);
+	else
+		s.depth = 1;
+	sample_cnt += weight;
+
+	i = hash_bytes (s.pcs, s.depth * sizeof *s.pcs) % STACK_CNT;
+	for (probe = 0; probe < MAX_PROBES; probe++, i = (i + 1) % STACK_CNT) {
+		struct stack *slot = &stacks[i];
+
+		if (slot->count == 0) {
+			memcpy (slot->pcs, s.pcs, sizeof s.pcs);
+			slot->depth = s.depth;
+		} else if (slot->depth != s.depth
+				|| memcmp (slot->pcs, s.pcs, s.depth * sizeof *s.pcs))
+			continue;
+		slot->count += weight;
+		return;
+	}
+	lost_cnt += weight;
+}
+
+/* Stops sampling and prints the samples, a line per distinct stack:
+   "profile:", the number of samples, and the stack in hex,
+   innermost frame first. */
+void
+profile_print (void) {
+	size_t i;
+	int j;
+
+	if (!profiling)
+		return;
+	profiling = false;
+
+	printf ("Profile: %llu samples at %d Hz, %llu lost\n",
+			sample_cnt, sample_hz, lost_cnt);
+	for (i = 0; i < STACK_CNT; i++) {
+		const struct stack *s = &stacks[i];
+
+		if (s->count == 0)
+			continue;
+		printf ("profile: %llu", s->count);
+		for (j = 0; j < s->depth; j++)
+			printf (" %llx", s->pcs[j]);
+		printf ("\n");
+	}
+}
@@ -1,10 +1,14 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include "devices/timer.h"
 #include "threads/flags.h"
+#include "threads/fpu.h"
+#include "threads/trace.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
@@ -12,6 +16,7 @@
 #include "threads/vaddr.h"
 #include "intrinsic.h"
 #ifdef USERPROG
+#include "userprog/child.h"
 #include "userprog/process.h"
 #endif
 
@@ -43,11 +48,13 @@ static struct lock tid_lock;
 /* Thread destruction requests */
 static struct list destruction_req;
 
-/* Statistics. */
-static long long idle_ticks;    /* # of timer ticks spent idle. */
-static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
-static long long user_ticks;    /* # of timer ticks in user programs. */
-static int64_t global_tick=INT64_MAX; /*[alarm clock] global tick 선언*/ 
+/* Statistics.  Time is charged to whichever thread was running at
+   each timer tick and each switch, as read from timer_now_ns(). */
+static int64_t idle_ns;         /* # of ns spent idle. */
+static int64_t kernel_ns;       /* # of ns in kernel threads. */
+static int64_t user_ns;         /* # of ns in user programs. */
+static int64_t charged_until;   /* When the running thread was last charged. */
+static int64_t next_wakeup=INT64_MAX; /*[alarm clock] 가장 이른 wakeup 시각 (ns)*/ 
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
@@ -140,6 +147,24 @@ thread_start (void) {
 	sema_down (&idle_started);
 }
 
+/* Charges the time since the last charge to T, the running
+   thread. */
+static void
+charge_time (struct thread *t) {
+	int64_t now = timer_now_ns ();
+	int64_t delta = now - charged_until;
+
+	charged_until = now;
+	if (t == idle_thread)
+		idle_ns += delta;
+#ifdef USERPROG
+	else if (t->pml4 != NULL)
+		user_ns += delta;
+#endif
+	else
+		kernel_ns += delta;
+}
+
 /* Called by the timer interrupt handler at each timer tick.
    Thus, this function runs in an external interrupt context. */
 void
@@ -147,14 +172,7 @@ thread_tick (void) {
 	struct thread *t = thread_current ();
 
 	/* Update statistics. */
-	if (t == idle_thread)
-		idle_ticks++;
-#ifdef USERPROG
-	else if (t->pml4 != NULL)
-		user_ticks++;
-#endif
-	else
-		kernel_ticks++;	
+	charge_time (t);
 
 	/* Enforce preemption. */
 	if (++thread_ticks >= TIME_SLICE)
@@ -164,8 +182,9 @@ thread_tick (void) {
 /* Prints thread statistics. */
 void
 thread_print_stats (void) {
-	printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
-			idle_ticks, kernel_ticks, user_ticks);
+	printf ("Thread: %"PRId64" us idle, %"PRId64" us kernel, "
+			"%"PRId64" us user\n",
+			idle_ns / 1000, kernel_ns / 1000, user_ns / 1000);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -199,6 +218,13 @@ thread_create (const char *name, int priority,
 	/* Initialize thread. */
 	init_thread (t, name, priority);
 	tid = t->tid = allocate_tid ();
+	trace_thread_name (tid, name);
+#ifdef USERPROG
+	if (!child_register (t)) {
+		palloc_free_page (t);
+		return TID_ERROR;
+	}
+#endif
 
 	/* Call the kernel_thread if it scheduled.
 	 * Note) rdi is 1st argument, and rsi is 2nd argument. */
@@ -230,6 +256,7 @@ void
 thread_block (void) {
 	ASSERT (!intr_context ());
 	ASSERT (intr_get_level () == INTR_OFF);
+	TRACE (TRACE_BLOCK, 0, 0);
 	thread_current ()->status = THREAD_BLOCKED;
 	schedule ();
 }
@@ -250,6 +277,7 @@ thread_unblock (struct thread *t) {
 
 	old_level = intr_disable ();
 	ASSERT (t->status == THREAD_BLOCKED);
+	TRACE (TRACE_UNBLOCK, t->tid, 0);
 	list_push_back (&ready_list, &t->elem);
 	t->status = THREAD_READY;
 	intr_set_level (old_level);
@@ -294,6 +322,7 @@ thread_exit (void) {
 #ifdef USERPROG
 	process_exit ();
 #endif
+	fpu_reset ();
 
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
@@ -306,7 +335,7 @@ thread_exit (void) {
 /* When you manipulate thread list, disable interrupt! */
   //1.sleep queue에 thread를 넣어야함.
   //2.wakeup()함수를 호출해야함.
-void thread_sleep(int64_t ticks){
+void thread_sleep(int64_t wakeup_time){
   struct thread *cur=thread_current();
   enum intr_level old_level;
 
@@ -314,27 +343,27 @@ void thread_sleep(int64_t ticks){
   old_level = intr_disable ();
 
   if(cur!=idle_thread){           //if the current thread is not idle thread
-    cur->wakeup_tick=ticks;          //store the local tick to wake up,
+    cur->wakeup_time=wakeup_time;    //store the time to wake up,
     cur->status = THREAD_BLOCKED;    //change the state of the caller thread to BLOCKED,
     list_push_back(&sleep_list,&cur->elem);//sleep list로 푸쉬해야함.
-    if(global_tick>cur->wakeup_tick) //update the global tick if necessary
-      global_tick=cur->wakeup_tick;
+    if(next_wakeup>cur->wakeup_time) //update the next wakeup if necessary
+      next_wakeup=cur->wakeup_time;
     schedule ();//and call schedule() */
   }
   intr_set_level (old_level);
 }
 
 //[alarm clock]
-void check_sleep_list(int64_t ticks){
-  if(ticks>=global_tick){ 
+void check_sleep_list(int64_t now){
+  if(now>=next_wakeup){ 
     struct list_elem * e;
-    global_tick=INT64_MAX;
+    next_wakeup=INT64_MAX;
     for(e=list_begin(&sleep_list);e!=list_end(&sleep_list);){
       struct list_elem * next=list_next(e);
       struct thread* t=list_entry(e,struct thread, elem);
-      if(ticks<t->wakeup_tick){
-        if(global_tick>t->wakeup_tick){
-          global_tick=t->wakeup_tick;
+      if(now<t->wakeup_time){
+        if(next_wakeup>t->wakeup_time){
+          next_wakeup=t->wakeup_time;
         }
       }else{
         wakeup(e,t);
@@ -344,6 +373,11 @@ void check_sleep_list(int64_t ticks){
   }
 }
 
+//[alarm clock] 가장 이른 wakeup 시각, 없으면 INT64_MAX
+int64_t thread_next_wakeup(void){
+  return next_wakeup;
+}
+
 //[alarm clock]
 void wakeup(struct list_elem* e, struct thread* t){
   list_remove(e);
@@ -438,7 +472,11 @@ idle (void *idle_started_ UNUSED) {
 		   time.
 
 		   See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-		   7.11.1 "HLT Instruction". */
+		   7.11.1 "HLT Instruction".
+
+		   Nothing needs the timer to tick while we are halted, so
+		   only wakeups will interrupt us. */
+		timer_idle_enter ();
 		asm volatile ("sti; hlt" : : : "memory");
 	}
 }
@@ -468,6 +506,10 @@ init_thread (struct thread *t, const char *name, int priority) {
 	t->tf.rsp = (uint64_t) t + PGSIZE - sizeof (void *);
 	t->priority = priority;
 	t->magic = THREAD_MAGIC;
+#ifdef USERPROG
+	list_init (&t->exited_children);
+	sema_init (&t->child_exited, 0);
+#endif
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
@@ -611,6 +653,17 @@ schedule (void) {
 	/* Start new time slice. */
 	thread_ticks = 0;
 
+	/* Let NEXT at the FPU if its registers are loaded. */
+	fpu_switch (next);
+
+	/* Leaving the idle thread: the timer goes back to ticking. */
+	if (curr == idle_thread && next != idle_thread)
+		timer_idle_exit ();
+	if (curr != next) {
+		TRACE (TRACE_SCHEDULE, next->tid, curr->status);
+		charge_time (curr);
+	}
+
 #ifdef USERPROG
 	/* Activate the new address space. */
 	process_activate (next);
@@ -0,0 +1,209 @@
+#include "threads/trace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/disk.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Kernel event tracing.
+ *
+ * With -trace on the kernel command line, the trace points
+ * scattered through the kernel append fixed-size binary records to
+ * a ring of TRACE_PAGES pages, in place of the printf() calls that
+ * would otherwise perturb the timing being looked at.  A record
+ * costs a read of the time stamp counter and a few stores.  Claiming
+ * a slot is a single atomic add, so interrupt handlers may record
+ * events in the middle of a thread doing the same without locks or
+ * turning interrupts off.  When the ring fills, the oldest records
+ * are overwritten.
+ *
+ * At power off the ring is written to the end of the scratch disk:
+ * the records, oldest first, followed by a header in the disk's
+ * last sector that says where they start.  `pintos --trace FILE'
+ * leaves room for them and copies them out to FILE, and
+ * utils/trace2json turns that into a timeline for a Chrome-trace
+ * viewer.
+ *
+ * Without a scratch disk to write to, as in a kernel built without
+ * FILESYS, the records are printed to the console instead, one
+ * "trace:" line each, in hex.  utils/trace2json reads a saved copy
+ * of that output as well. */
+
+/* Size of the ring. */
+#define TRACE_PAGES 256
+#define RECORD_CNT (TRACE_PAGES * PGSIZE / sizeof (struct trace_record))
+
+/* Records in a disk sector. */
+#define SECTOR_RECORDS (DISK_SECTOR_SIZE / sizeof (struct trace_record))
+
+/* Header of a trace on disk. */
+struct trace_header {
+	char magic[8];              /* "PINTRACE". */
+	uint32_t version;           /* 1. */
+	uint32_t record_size;       /* sizeof (struct trace_record). */
+	uint64_t record_cnt;        /* Records written. */
+	uint64_t lost_cnt;          /* Older records overwritten. */
+	uint64_t tsc_hz;            /* TSC rate, or 0 if unknown. */
+	uint64_t first_sector;      /* Sector holding the first record. */
+};
+
+/* Whether events are being recorded. */
+bool trace_enabled;
+
+static struct trace_record *records;    /* Ring of RECORD_CNT records. */
+static uint64_t next_record;            /* Records ever claimed. */
+
+static void put (int tid, enum trace_event, uint64_t arg0, uint64_t arg1);
+#ifdef FILESYS
+static bool dump_disk (uint64_t cnt, uint64_t first);
+#endif
+static void dump_console (uint64_t cnt, uint64_t first);
+
+/* Allocates the ring and starts recording events. */
+void
+trace_init (void) {
+	records = palloc_get_multiple (0, TRACE_PAGES);
+	if (records == NULL) {
+		printf ("trace: no memory for %d-page buffer\n", TRACE_PAGES);
+		return;
+	}
+	trace_enabled = true;
+}
+
+/* Records EVENT on the running thread.  Use the TRACE macro, which
+   checks whether tracing is on first. */
+void
+trace_record (enum trace_event event, uint64_t arg0, uint64_t arg1) {
+	/* Not thread_current (), which objects to being called from the
+	   middle of schedule (). */
+	struct thread *t = pg_round_down (rrsp ());
+	put (t->tid, event, arg0, arg1);
+}
+
+/* Records that thread TID is called NAME, so that the timeline can
+   label it. */
+void
+trace_thread_name (int tid, const char *name) {
+	uint64_t parts[2] = { 0, 0 };
+
+	if (!trace_enabled)
+		return;
+	strlcpy ((char *) parts, name, sizeof parts);
+	put (tid, TRACE_THREAD_NAME, parts[0], parts[1]);
+}
+
+/* Fills in the next record in the ring. */
+static void
+put (int tid, enum trace_event event, uint64_t arg0, uint64_t arg1) {
+	uint64_t idx = __atomic_fetch_add (&next_record, 1, __ATOMIC_RELAXED);
+	struct trace_record *r = &records[idx % RECORD_CNT];
+
+	r->tsc = rdtsc ();
+	r->event = event;
+	r->tid = tid;
+	r->arg0 = arg0;
+	r->arg1 = arg1;
+}
+
+/* Stops recording and writes the trace out, to the scratch disk if
+   there is one, otherwise to the console.  Does nothing if tracing
+   is off. */
+void
+trace_dump (void) {
+	uint64_t cnt, first;
+
+	if (!trace_enabled)
+		return;
+	trace_enabled = false;
+
+	cnt = next_record < RECORD_CNT ? next_record : RECORD_CNT;
+	first = next_record - cnt;
+#ifdef FILESYS
+	if (dump_disk (cnt, first))
+		return;
+#endif
+	dump_console (cnt, first);
+}
+
+#ifdef FILESYS
+/* Writes the CNT records starting with record FIRST to the scratch
+   disk.  Returns false, having written nothing, if that is not
+   possible.  Needs interrupts on to use the disk. */
+static bool
+dump_disk (uint64_t cnt, uint64_t first) {
+	struct trace_header *h;
+	struct trace_record *sector;
+	struct disk *d;
+	uint64_t i;
+	disk_sector_t sector_cnt, first_sector, s;
+
+	if (intr_context () || intr_get_level () == INTR_OFF) {
+		printf ("trace: interrupts are off, cannot use scratch disk\n");
+		return false;
+	}
+	d = disk_get (1, 0);
+	if (d == NULL) {
+		printf ("trace: no scratch disk (hdc or hd1:0)\n");
+		return false;
+	}
+
+	sector_cnt = DIV_ROUND_UP (cnt, SECTOR_RECORDS);
+	if (disk_size (d) < sector_cnt + 1) {
+		printf ("trace: scratch disk too small\n");
+		return false;
+	}
+	first_sector = disk_size (d) - 1 - sector_cnt;
+
+	sector = palloc_get_page (0);
+	if (sector == NULL) {
+		printf ("trace: out of memory for scratch disk buffer\n");
+		return false;
+	}
+	for (s = 0; s < sector_cnt; s++) {
+		memset (sector, 0, DISK_SECTOR_SIZE);
+		for (i = 0; i < SECTOR_RECORDS && s * SECTOR_RECORDS + i < cnt; i++)
+			sector[i] = records[(first + s * SECTOR_RECORDS + i) % RECORD_CNT];
+		disk_write (d, first_sector + s, sector);
+	}
+
+	h = (struct trace_header *) sector;
+	memset (h, 0, DISK_SECTOR_SIZE);
+	memcpy (h->magic, "PINTRACE", sizeof h->magic);
+	h->version = 1;
+	h->record_size = sizeof (struct trace_record);
+	h->record_cnt = cnt;
+	h->lost_cnt = first;
+	h->tsc_hz = timer_tsc_hz ();
+	h->first_sector = first_sector;
+	disk_write (d, disk_size (d) - 1, h);
+	palloc_free_page (sector);
+
+	printf ("trace: %"PRIu64" events written to scratch disk, %"PRIu64" lost\n",
+			cnt, first);
+	return true;
+}
+#endif
+
+/* Prints the CNT records starting with record FIRST to the console,
+   after a line with the same fields as the disk header. */
+static void
+dump_console (uint64_t cnt, uint64_t first) {
+	uint64_t i;
+
+	printf ("trace: PINTRACE %"PRIu64" records %"PRIu64" lost %"PRIu64" hz\n",
+			cnt, first, timer_tsc_hz ());
+	for (i = 0; i < cnt; i++) {
+		struct trace_record *r = &records[(first + i) % RECORD_CNT];
+		printf ("trace: %"PRIx64" %"PRIx32" %"PRIx32" %"PRIx64" %"PRIx64"\n",
+				r->tsc, r->event, (uint32_t) r->tid, r->arg0, r->arg1);
+	}
+	printf ("trace: %"PRIu64" events written to console, %"PRIu64" lost\n",
+			cnt, first);
+}
@@ -0,0 +1,217 @@
+#include "userprog/child.h"
+#include <hash.h>
+#include <list.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Exit status of child processes.
+ *
+ * The exit status of a process outlives its struct thread.  Each child
+ * has a struct child_status that it and its parent both hold a
+ * reference to, and whichever lets go last frees it.  A child that
+ * exits leaves its status there, and its thread page is freed right
+ * away instead of waiting for the parent to collect the status.
+ *
+ * A parent finds the record of a child by tid in a hash table of its
+ * own, so wait() takes the same time however many children there are.
+ * Records of children that exited but have not been waited for are
+ * also on the parent's EXITED_CHILDREN list, oldest first, which is
+ * where wait_any() takes them from.
+ *
+ * Only the parent uses its table.  The list, the records' PARENT
+ * pointers and the reference counts are shared with children exiting
+ * on other threads, so they are only touched with interrupts off. */
+
+struct child_status {
+	struct hash_elem elem;      /* Element in the parent's CHILDREN. */
+	struct list_elem exit_elem; /* Element in the parent's EXITED_CHILDREN. */
+	tid_t tid;                  /* The child's thread id. */
+	struct thread *parent;      /* The parent, or null once it exits. */
+	int status;                 /* Exit status, once EXITED. */
+	bool exited;                /* Has the child exited? */
+	int ref_cnt;                /* Whether parent and child are alive. */
+};
+
+/* Returns a hash value for the record E belongs to. */
+static uint64_t
+child_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_int (hash_entry (e, struct child_status, elem)->tid);
+}
+
+/* Returns true if record A precedes record B. */
+static bool
+child_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct child_status, elem)->tid
+		< hash_entry (b, struct child_status, elem)->tid;
+}
+
+/* Drops a reference to CS, freeing it if that was the last one. */
+static void
+child_put (struct child_status *cs) {
+	enum intr_level old_level = intr_disable ();
+	bool last = --cs->ref_cnt == 0;
+	intr_set_level (old_level);
+
+	if (last)
+		free (cs);
+}
+
+/* Makes CHILD, a thread being created, a child of the current thread.
+ * Returns false if memory runs out. */
+bool
+child_register (struct thread *child) {
+	struct thread *parent = thread_current ();
+	struct child_status *cs;
+
+	if (parent->children == NULL) {
+		parent->children = malloc (sizeof *parent->children);
+		if (parent->children == NULL
+				|| !hash_init (parent->children, child_hash, child_less, NULL)) {
+			free (parent->children);
+			parent->children = NULL;
+			return false;
+		}
+	}
+
+	cs = malloc (sizeof *cs);
+	if (cs == NULL)
+		return false;
+	cs->tid = child->tid;
+	cs->parent = parent;
+	cs->status = -1;
+	cs->exited = false;
+	cs->ref_cnt = 2;
+	hash_insert (parent->children, &cs->elem);
+
+	/* Unless it calls exit(), a process exits with -1. */
+	child->exit_status = -1;
+	child->exit_record = cs;
+	return true;
+}
+
+/* Records STATUS as the exit status of the current thread, waking its
+ * parent if it is waiting. */
+void
+child_exit (int status) {
+	struct thread *t = thread_current ();
+	struct child_status *cs = t->exit_record;
+	enum intr_level old_level;
+
+	if (cs == NULL)
+		return;
+	t->exit_record = NULL;
+
+	old_level = intr_disable ();
+	cs->status = status;
+	cs->exited = true;
+	if (cs->parent != NULL) {
+		struct thread *parent = cs->parent;
+
+		list_push_back (&parent->exited_children, &cs->exit_elem);
+		if (parent->waiting_child) {
+			parent->waiting_child = false;
+			sema_up (&parent->child_exited);
+		}
+	}
+	intr_set_level (old_level);
+	child_put (cs);
+}
+
+/* Lets go of child record E for a parent that is exiting. */
+static void
+orphan (struct hash_elem *e, void *aux UNUSED) {
+	struct child_status *cs = hash_entry (e, struct child_status, elem);
+	enum intr_level old_level = intr_disable ();
+
+	cs->parent = NULL;
+	intr_set_level (old_level);
+	child_put (cs);
+}
+
+/* Lets go of the records of all of the current thread's children, so
+ * that the ones still running free theirs when they exit. */
+void
+child_release_all (void) {
+	struct thread *t = thread_current ();
+
+	if (t->children == NULL)
+		return;
+	hash_destroy (t->children, orphan);
+	free (t->children);
+	t->children = NULL;
+}
+
+/* Forgets exited child CS, which must be off EXITED_CHILDREN, and
+ * returns its exit status. */
+static int
+reap (struct child_status *cs) {
+	int status = cs->status;
+
+	hash_delete (thread_current ()->children, &cs->elem);
+	child_put (cs);
+	return status;
+}
+
+/* Sleeps until a child exits.  Interrupts must be off. */
+static void
+sleep_for_child (void) {
+	struct thread *t = thread_current ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	t->waiting_child = true;
+	sema_down (&t->child_exited);
+}
+
+/* Waits for the current thread's child TID to exit and returns its exit
+ * status.  Returns -1 at once if TID is not a child, or has already been
+ * waited for. */
+int
+child_wait (tid_t tid) {
+	struct thread *t = thread_current ();
+	struct child_status key, *cs;
+	struct hash_elem *e;
+	enum intr_level old_level;
+
+	if (t->children == NULL)
+		return -1;
+	key.tid = tid;
+	e = hash_find (t->children, &key.elem);
+	if (e == NULL)
+		return -1;
+	cs = hash_entry (e, struct child_status, elem);
+
+	old_level = intr_disable ();
+	while (!cs->exited)
+		sleep_for_child ();
+	list_remove (&cs->exit_elem);
+	intr_set_level (old_level);
+	return reap (cs);
+}
+
+/* Waits for any child of the current thread to exit, stores its exit
+ * status in *STATUS, and returns its tid.  Children that have exited
+ * already are reaped first, oldest first.  Returns TID_ERROR at once if
+ * there are no children left to wait for. */
+tid_t
+child_wait_any (int *status) {
+	struct thread *t = thread_current ();
+	struct child_status *cs;
+	enum intr_level old_level;
+	tid_t tid;
+
+	if (t->children == NULL || hash_empty (t->children))
+		return TID_ERROR;
+
+	old_level = intr_disable ();
+	while (list_empty (&t->exited_children))
+		sleep_for_child ();
+	cs = list_entry (list_pop_front (&t->exited_children),
+			struct child_status, exit_elem);
+	intr_set_level (old_level);
+
+	tid = cs->tid;
+	*status = reap (cs);
+	return tid;
+}
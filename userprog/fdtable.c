@@ -0,0 +1,348 @@
+#include "userprog/fdtable.h"
+#include <bitmap.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "userprog/pipe.h"
+
+/* File descriptor tables.
+ *
+ * A table starts with room for FD_INIT_SIZE descriptors and doubles
+ * whenever it fills up, up to FD_MAX.  Next to the array of open files
+ * it keeps a bitmap with a bit set for each descriptor in use, so the
+ * lowest free descriptor is found a whole word of the bitmap at a
+ * time rather than by walking the array.
+ *
+ * Each descriptor refers to an open file description, struct
+ * open_file, which dup2() lets several descriptors share.  What it
+ * refers to is closed when the last descriptor referring to it is.
+ *
+ * fork() does not copy the table.  The child shares the parent's table
+ * until one of the two goes to use a descriptor, which first gives it
+ * a table of its own with a copy of each description: duplicates of
+ * the files, and another reference to each pipe end.  Since a struct
+ * file carries the file position, even a read has to unshare; the
+ * point is that a child that never touches its descriptors, or exits,
+ * never pays for duplicating them.  Whoever unshares last keeps the
+ * original table, which no one has touched since the fork. */
+
+/* Number of descriptors a new table has room for. */
+#define FD_INIT_SIZE 64
+
+struct fd_table {
+	struct lock lock;           /* Protects REF_CNT. */
+	int ref_cnt;                /* Number of processes sharing the table. */
+	size_t size;                /* Number of slots in FILES. */
+	struct open_file **files;   /* Description of each descriptor, or null. */
+	struct bitmap *used;        /* Bit set for each descriptor in use. */
+};
+
+/* Returns a new description of OBJECT, of type TYPE, with no
+ * descriptors referring to it yet, or a null pointer if memory runs
+ * out. */
+static struct open_file *
+open_file_create (enum fd_type type, void *object) {
+	struct open_file *of = malloc (sizeof *of);
+	if (of == NULL)
+		return NULL;
+
+	of->type = type;
+	of->ref_cnt = 0;
+	of->file = type == FD_FILE ? object : NULL;
+	of->pipe = type == FD_PIPE_READ || type == FD_PIPE_WRITE ? object : NULL;
+	of->copy = NULL;
+	return of;
+}
+
+/* Returns a copy of OF for a table being unshared, or a null pointer
+ * if memory runs out. */
+static struct open_file *
+open_file_copy (struct open_file *of) {
+	struct open_file *copy;
+	void *object = NULL;
+
+	if (of->type == FD_FILE) {
+		object = file_duplicate (of->file);
+		if (object == NULL)
+			return NULL;
+	} else if (of->pipe != NULL)
+		object = of->pipe;
+
+	copy = open_file_create (of->type, object);
+	if (copy == NULL) {
+		if (of->type == FD_FILE)
+			file_close (object);
+	} else if (of->pipe != NULL)
+		pipe_dup (of->pipe, of->type == FD_PIPE_WRITE);
+	return copy;
+}
+
+/* Drops a descriptor's reference to OF, closing what it refers to and
+ * freeing it if that was the last one. */
+static void
+open_file_put (struct open_file *of) {
+	if (--of->ref_cnt > 0)
+		return;
+	if (of->type == FD_FILE) {
+		lock_acquire (&filesys_lock);
+		file_close (of->file);
+		lock_release (&filesys_lock);
+	} else if (of->pipe != NULL)
+		pipe_close (of->pipe, of->type == FD_PIPE_WRITE);
+	free (of);
+}
+
+/* Points descriptor FD of FDT, which must be free and within the
+ * table, at OF. */
+static void
+set_fd (struct fd_table *fdt, size_t fd, struct open_file *of) {
+	fdt->files[fd] = of;
+	of->ref_cnt++;
+	bitmap_mark (fdt->used, fd);
+}
+
+/* Returns a new, empty table with room for SIZE descriptors, or a null
+ * pointer if memory runs out. */
+static struct fd_table *
+alloc_table (size_t size) {
+	struct fd_table *fdt = malloc (sizeof *fdt);
+	if (fdt == NULL)
+		return NULL;
+
+	fdt->files = calloc (size, sizeof *fdt->files);
+	fdt->used = bitmap_create (size);
+	if (fdt->files == NULL || fdt->used == NULL) {
+		free (fdt->files);
+		if (fdt->used != NULL)
+			bitmap_destroy (fdt->used);
+		free (fdt);
+		return NULL;
+	}
+	lock_init (&fdt->lock);
+	fdt->ref_cnt = 1;
+	fdt->size = size;
+	return fdt;
+}
+
+/* Closes the descriptors in FDT and frees it. */
+static void
+free_table (struct fd_table *fdt) {
+	size_t fd;
+
+	for (fd = bitmap_scan (fdt->used, 0, 1, true); fd != BITMAP_ERROR;
+			fd = bitmap_scan (fdt->used, fd + 1, 1, true))
+		open_file_put (fdt->files[fd]);
+	bitmap_destroy (fdt->used);
+	free (fdt->files);
+	free (fdt);
+}
+
+/* Returns a new table with the console open on descriptors 0 and 1,
+ * or a null pointer if memory runs out. */
+struct fd_table *
+fd_table_create (void) {
+	struct fd_table *fdt = alloc_table (FD_INIT_SIZE);
+	struct open_file *in = open_file_create (FD_STDIN, NULL);
+	struct open_file *out = open_file_create (FD_STDOUT, NULL);
+
+	if (fdt == NULL || in == NULL || out == NULL) {
+		if (fdt != NULL)
+			free_table (fdt);
+		free (in);
+		free (out);
+		return NULL;
+	}
+	set_fd (fdt, 0, in);
+	set_fd (fdt, 1, out);
+	return fdt;
+}
+
+/* Returns FDT with one more process sharing it.  FDT may be null, in
+ * which case so is the result. */
+struct fd_table *
+fd_table_share (struct fd_table *fdt) {
+	if (fdt != NULL) {
+		lock_acquire (&fdt->lock);
+		fdt->ref_cnt++;
+		lock_release (&fdt->lock);
+	}
+	return fdt;
+}
+
+/* Drops a process's reference to FDT, closing its descriptors and
+ * freeing it if that was the last one.  FDT may be null. */
+void
+fd_table_release (struct fd_table *fdt) {
+	int ref_cnt;
+
+	if (fdt == NULL)
+		return;
+	lock_acquire (&fdt->lock);
+	ref_cnt = --fdt->ref_cnt;
+	lock_release (&fdt->lock);
+	if (ref_cnt == 0)
+		free_table (fdt);
+}
+
+/* Makes *FDTP a table that the caller alone uses, creating it if it is
+ * null and copying it if it is shared.  Returns false if memory runs
+ * out, leaving *FDTP as it was. */
+static bool
+own_table (struct fd_table **fdtp) {
+	struct fd_table *fdt = *fdtp, *copy;
+	bool success = true;
+	size_t fd;
+
+	if (fdt == NULL) {
+		*fdtp = fd_table_create ();
+		return *fdtp != NULL;
+	}
+
+	lock_acquire (&fdt->lock);
+	if (fdt->ref_cnt == 1) {
+		lock_release (&fdt->lock);
+		return true;
+	}
+
+	copy = alloc_table (fdt->size);
+	if (copy == NULL) {
+		lock_release (&fdt->lock);
+		return false;
+	}
+	/* Descriptors sharing a description get a shared copy of it. */
+	for (fd = bitmap_scan (fdt->used, 0, 1, true); fd != BITMAP_ERROR;
+			fd = bitmap_scan (fdt->used, fd + 1, 1, true)) {
+		struct open_file *of = fdt->files[fd];
+
+		if (of->copy == NULL && (of->copy = open_file_copy (of)) == NULL) {
+			success = false;
+			break;
+		}
+		set_fd (copy, fd, of->copy);
+	}
+	for (fd = bitmap_scan (fdt->used, 0, 1, true); fd != BITMAP_ERROR;
+			fd = bitmap_scan (fdt->used, fd + 1, 1, true))
+		fdt->files[fd]->copy = NULL;
+
+	if (success) {
+		fdt->ref_cnt--;
+		*fdtp = copy;
+	} else
+		free_table (copy);
+	lock_release (&fdt->lock);
+	return success;
+}
+
+/* Grows FDT, which the caller must own, to at least SIZE descriptors.
+ * Returns false if SIZE is over FD_MAX or memory runs out. */
+static bool
+grow_table (struct fd_table *fdt, size_t size) {
+	size_t new_size = fdt->size;
+	struct open_file **files;
+	struct bitmap *used;
+	size_t fd;
+
+	if (size > FD_MAX)
+		return false;
+	while (new_size < size)
+		new_size *= 2;
+	if (new_size > FD_MAX)
+		new_size = FD_MAX;
+
+	files = calloc (new_size, sizeof *files);
+	used = bitmap_create (new_size);
+	if (files == NULL || used == NULL) {
+		free (files);
+		if (used != NULL)
+			bitmap_destroy (used);
+		return false;
+	}
+
+	memcpy (files, fdt->files, fdt->size * sizeof *files);
+	for (fd = bitmap_scan (fdt->used, 0, 1, true); fd != BITMAP_ERROR;
+			fd = bitmap_scan (fdt->used, fd + 1, 1, true))
+		bitmap_mark (used, fd);
+	free (fdt->files);
+	bitmap_destroy (fdt->used);
+	fdt->files = files;
+	fdt->used = used;
+	fdt->size = new_size;
+	return true;
+}
+
+/* Opens OBJECT, a struct file for FD_FILE or a struct pipe for the
+ * pipe ends, on the lowest free descriptor in *FDTP, of which it takes
+ * ownership.  Returns the descriptor, or -1 if the table is full or
+ * memory runs out, in which case the caller keeps OBJECT. */
+int
+fd_table_install (struct fd_table **fdtp, enum fd_type type, void *object) {
+	struct fd_table *fdt;
+	struct open_file *of;
+	size_t fd;
+
+	if (!own_table (fdtp))
+		return -1;
+	fdt = *fdtp;
+
+	fd = bitmap_scan (fdt->used, 0, 1, false);
+	if (fd == BITMAP_ERROR) {
+		fd = fdt->size;
+		if (!grow_table (fdt, fd + 1))
+			return -1;
+	}
+	of = open_file_create (type, object);
+	if (of == NULL)
+		return -1;
+	set_fd (fdt, fd, of);
+	return fd;
+}
+
+/* Returns the description FD refers to in *FDTP, or a null pointer if
+ * FD is not open. */
+struct open_file *
+fd_table_get (struct fd_table **fdtp, int fd) {
+	if (fd < 0 || fd >= FD_MAX || !own_table (fdtp))
+		return NULL;
+	if ((size_t) fd >= (*fdtp)->size)
+		return NULL;
+	return (*fdtp)->files[fd];
+}
+
+/* Closes descriptor FD in *FDTP.  Returns false if FD was not open. */
+bool
+fd_table_close (struct fd_table **fdtp, int fd) {
+	struct open_file *of = fd_table_get (fdtp, fd);
+
+	if (of == NULL)
+		return false;
+	(*fdtp)->files[fd] = NULL;
+	bitmap_reset ((*fdtp)->used, fd);
+	open_file_put (of);
+	return true;
+}
+
+/* Makes NEWFD in *FDTP refer to the description OLDFD does, closing
+ * NEWFD first if it is open.  Returns NEWFD, or -1 if OLDFD is not
+ * open, NEWFD is out of range or memory runs out. */
+int
+fd_table_dup2 (struct fd_table **fdtp, int oldfd, int newfd) {
+	struct open_file *of = fd_table_get (fdtp, oldfd);
+	struct fd_table *fdt = *fdtp;
+
+	if (of == NULL || newfd < 0 || newfd >= FD_MAX)
+		return -1;
+	if (oldfd == newfd)
+		return newfd;
+	if ((size_t) newfd >= fdt->size && !grow_table (fdt, newfd + 1))
+		return -1;
+
+	/* Take the new reference first, in case closing NEWFD drops the
+	   last other one. */
+	of->ref_cnt++;
+	fd_table_close (fdtp, newfd);
+	set_fd (fdt, newfd, of);
+	of->ref_cnt--;
+	return newfd;
+}
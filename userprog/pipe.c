@@ -0,0 +1,321 @@
+#include "userprog/pipe.h"
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/uaccess.h"
+
+/* Pipes.
+ *
+ * Data goes through a ring buffer of one page.  The reader only ever
+ * advances HEAD and the writer only ever advances TAIL, so the two
+ * sides never wait on each other for a lock: each copies between its
+ * own user buffer and the ring with interrupts on, and only publishes
+ * the new index, and wakes the other side if it is asleep, with
+ * interrupts off.  Several processes may hold the same end of a pipe
+ * after fork() or dup2(); READ_LOCK and WRITE_LOCK make them take
+ * turns, so the ring itself always has a single producer and a single
+ * consumer.
+ *
+ * A reader that finds the pipe empty leaves a description of its
+ * buffer in the pipe before going to sleep.  A writer with at least a
+ * page of data that finds such a read posted copies straight from its
+ * own buffer into the reader's pages, looked up in the reader's page
+ * table, instead of into the ring for the reader to copy out again.
+ * That halves the copying for bulk transfers.  Pages of the reader's
+ * buffer that are not mapped yet are left to the ring. */
+
+/* Size of the ring.  Must be a power of two. */
+#define PIPE_SIZE PGSIZE
+
+/* Smallest write that tries to hand its data to a reader directly. */
+#define HANDOFF_MIN PGSIZE
+
+/* State of the read posted in a pipe. */
+enum handoff_state {
+	HANDOFF_NONE,               /* No read posted. */
+	HANDOFF_POSTED,             /* Reader asleep, buffer up for grabs. */
+	HANDOFF_CLAIMED,            /* A writer is copying into the buffer. */
+	HANDOFF_DONE                /* Writer done, HAND_DONE bytes copied. */
+};
+
+struct pipe {
+	uint8_t *buf;               /* Ring of PIPE_SIZE bytes. */
+	uint32_t head;              /* Bytes ever read, advanced by reader. */
+	uint32_t tail;              /* Bytes ever written, advanced by writer. */
+
+	struct lock read_lock;      /* Held by the reading process. */
+	struct lock write_lock;     /* Held by the writing process. */
+	struct semaphore readable;  /* Wakes the reader. */
+	struct semaphore writable;  /* Wakes the writer. */
+	bool reader_waiting;        /* Reader asleep on READABLE? */
+	bool writer_waiting;        /* Writer asleep on WRITABLE? */
+	int readers;                /* Open read ends. */
+	int writers;                /* Open write ends. */
+
+	/* Read posted by a reader asleep on an empty pipe. */
+	enum handoff_state hand_state;
+	uint64_t *hand_pml4;        /* Reader's page table. */
+	uint8_t *hand_buf;          /* Reader's buffer. */
+	size_t hand_size;           /* Size of HAND_BUF. */
+	size_t hand_done;           /* Bytes the writer copied into it. */
+};
+
+/* Returns a new pipe with one read end and one write end open, or a
+ * null pointer if memory runs out. */
+struct pipe *
+pipe_create (void) {
+	struct pipe *p = malloc (sizeof *p);
+	if (p == NULL)
+		return NULL;
+	p->buf = palloc_get_page (0);
+	if (p->buf == NULL) {
+		free (p);
+		return NULL;
+	}
+
+	p->head = p->tail = 0;
+	lock_init (&p->read_lock);
+	lock_init (&p->write_lock);
+	sema_init (&p->readable, 0);
+	sema_init (&p->writable, 0);
+	p->reader_waiting = p->writer_waiting = false;
+	p->readers = p->writers = 1;
+	p->hand_state = HANDOFF_NONE;
+	return p;
+}
+
+/* Wakes the reader of P if it is asleep.  Interrupts must be off. */
+static void
+wake_reader (struct pipe *p) {
+	if (p->reader_waiting) {
+		p->reader_waiting = false;
+		sema_up (&p->readable);
+	}
+}
+
+/* Wakes the writer of P if it is asleep.  Interrupts must be off. */
+static void
+wake_writer (struct pipe *p) {
+	if (p->writer_waiting) {
+		p->writer_waiting = false;
+		sema_up (&p->writable);
+	}
+}
+
+/* Opens another read end of P, or write end if WRITER is true. */
+void
+pipe_dup (struct pipe *p, bool writer) {
+	enum intr_level old_level = intr_disable ();
+	if (writer)
+		p->writers++;
+	else
+		p->readers++;
+	intr_set_level (old_level);
+}
+
+/* Closes a read end of P, or write end if WRITER is true, and frees
+ * P once both sides are closed.  Closing the last write end gives the
+ * reader end of file; closing the last read end breaks the pipe for
+ * the writer. */
+void
+pipe_close (struct pipe *p, bool writer) {
+	enum intr_level old_level = intr_disable ();
+	bool last;
+
+	if (writer) {
+		p->writers--;
+		wake_reader (p);
+	} else {
+		p->readers--;
+		wake_writer (p);
+	}
+	last = p->readers == 0 && p->writers == 0;
+	intr_set_level (old_level);
+
+	if (last) {
+		palloc_free_page (p->buf);
+		free (p);
+	}
+}
+
+/* Copies SIZE bytes between the ring of P, starting at byte POS of the
+ * stream, and user buffer UBUF, into the ring if TO_RING is true.
+ * Returns false if UBUF faults. */
+static bool
+ring_copy (struct pipe *p, uint32_t pos, uint8_t *ubuf, size_t size,
+		bool to_ring) {
+	size_t ofs = pos & (PIPE_SIZE - 1);
+	size_t first = size < PIPE_SIZE - ofs ? size : PIPE_SIZE - ofs;
+
+	if (to_ring)
+		return copy_from_user (p->buf + ofs, ubuf, first)
+			&& copy_from_user (p->buf, ubuf + first, size - first);
+	return copy_to_user (ubuf, p->buf + ofs, first)
+		&& copy_to_user (ubuf + first, p->buf, size - first);
+}
+
+/* Posts a read of SIZE bytes into UBUF in P, which is empty, and
+ * sleeps until a writer fills it in or there is something else to
+ * read.  Returns the number of bytes a writer copied in directly. */
+static size_t
+wait_readable (struct pipe *p, uint8_t *ubuf, size_t size) {
+	enum intr_level old_level = intr_disable ();
+	size_t done;
+
+	p->hand_pml4 = thread_current ()->pml4;
+	p->hand_buf = ubuf;
+	p->hand_size = size;
+	p->hand_done = 0;
+	p->hand_state = HANDOFF_POSTED;
+	while (p->hand_state == HANDOFF_CLAIMED
+			|| (p->hand_state == HANDOFF_POSTED
+				&& p->head == p->tail && p->writers > 0)) {
+		p->reader_waiting = true;
+		sema_down (&p->readable);
+	}
+	done = p->hand_state == HANDOFF_DONE ? p->hand_done : 0;
+	p->hand_state = HANDOFF_NONE;
+	intr_set_level (old_level);
+	return done;
+}
+
+/* Reads up to SIZE bytes from P into user buffer UBUF, sleeping until
+ * there is at least one byte to read.  Returns the number of bytes
+ * read, which is 0 at end of file.  Sets *FAULT and stops if UBUF is
+ * invalid. */
+int
+pipe_read (struct pipe *p, void *ubuf, size_t size, bool *fault) {
+	size_t done = 0;
+
+	lock_acquire (&p->read_lock);
+	while (size > 0) {
+		uint32_t avail = p->tail - p->head;
+
+		if (avail > 0) {
+			enum intr_level old_level;
+
+			done = avail < size ? avail : size;
+			if (!ring_copy (p, p->head, ubuf, done, false)) {
+				*fault = true;
+				done = 0;
+				break;
+			}
+			old_level = intr_disable ();
+			p->head += done;
+			wake_writer (p);
+			intr_set_level (old_level);
+			break;
+		}
+		if (p->writers == 0)
+			break;
+		done = wait_readable (p, ubuf, size);
+		if (done > 0)
+			break;
+	}
+	lock_release (&p->read_lock);
+	return done;
+}
+
+/* Copies up to SIZE bytes from user buffer UBUF straight into the
+ * buffer of a read posted in P, if there is one and the ring is
+ * empty.  Returns the number of bytes copied.  Sets *FAULT if UBUF is
+ * invalid. */
+static size_t
+handoff (struct pipe *p, const uint8_t *ubuf, size_t size, bool *fault) {
+	enum intr_level old_level = intr_disable ();
+	size_t done = 0;
+
+	if (p->hand_state != HANDOFF_POSTED || p->head != p->tail) {
+		intr_set_level (old_level);
+		return 0;
+	}
+	p->hand_state = HANDOFF_CLAIMED;
+	intr_set_level (old_level);
+
+	if (size > p->hand_size)
+		size = p->hand_size;
+	while (done < size) {
+		uint8_t *uaddr = p->hand_buf + done;
+		uint64_t *pte = pml4e_walk (p->hand_pml4, (uint64_t) uaddr, 0);
+		size_t chunk = PGSIZE - pg_ofs (uaddr);
+
+		/* Leave pages the reader could not write, or that it has
+		   not faulted in yet, to the ring. */
+		if (pte == NULL || !(*pte & PTE_P)
+				|| !is_writable (pte) || !is_user_pte (pte))
+			break;
+		if (chunk > size - done)
+			chunk = size - done;
+		if (!copy_from_user (pml4_get_page (p->hand_pml4, uaddr),
+					ubuf + done, chunk)) {
+			*fault = true;
+			break;
+		}
+		pml4_set_dirty (p->hand_pml4, uaddr, true);
+		done += chunk;
+	}
+
+	old_level = intr_disable ();
+	p->hand_done = done;
+	p->hand_state = HANDOFF_DONE;
+	wake_reader (p);
+	intr_set_level (old_level);
+	return done;
+}
+
+/* Writes SIZE bytes from user buffer UBUF to P, sleeping while the
+ * pipe is full.  Returns the number of bytes written, which is less
+ * than SIZE only if the last read end is closed, or -1 if it was
+ * closed before anything was written.  Sets *FAULT and stops if UBUF
+ * is invalid. */
+int
+pipe_write (struct pipe *p, const void *ubuf_, size_t size, bool *fault) {
+	const uint8_t *ubuf = ubuf_;
+	bool try_handoff = size >= HANDOFF_MIN;
+	size_t done = 0;
+
+	lock_acquire (&p->write_lock);
+	while (done < size && p->readers > 0 && !*fault) {
+		uint32_t space = PIPE_SIZE - (p->tail - p->head);
+		enum intr_level old_level;
+		size_t n;
+
+		if (try_handoff) {
+			n = handoff (p, ubuf + done, size - done, fault);
+			done += n;
+			/* No read was posted, or its buffer was not mapped:
+			   go through the ring until the reader catches up. */
+			try_handoff = n > 0;
+			continue;
+		}
+		if (space == 0) {
+			old_level = intr_disable ();
+			while (p->tail - p->head == PIPE_SIZE && p->readers > 0) {
+				p->writer_waiting = true;
+				sema_down (&p->writable);
+			}
+			intr_set_level (old_level);
+			/* The reader drained the ring and may be waiting. */
+			try_handoff = size - done >= HANDOFF_MIN;
+			continue;
+		}
+
+		n = size - done < space ? size - done : space;
+		if (!ring_copy (p, p->tail, (uint8_t *) ubuf + done, n, true)) {
+			*fault = true;
+			break;
+		}
+		old_level = intr_disable ();
+		p->tail += n;
+		wake_reader (p);
+		intr_set_level (old_level);
+		done += n;
+	}
+	lock_release (&p->write_lock);
+	return done == 0 && size > 0 && p->readers == 0 ? -1 : (int) done;
+}
@@ -8,12 +8,17 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/tss.h"
+#include "userprog/child.h"
+#include "userprog/fdtable.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
@@ -21,16 +26,43 @@
 #include "intrinsic.h"
 #include "threads/palloc.h"
 #include <string.h>
-#define FDT_PAGES DIV_ROUND_UP(FDCOUNT_LIMIT, 512)
 #ifdef VM
 #include "vm/vm.h"
 #endif
-#define FDCOUNT_LIMIT 128
 
 static void process_cleanup (void);
 static bool load (const char *file_name, struct intr_frame *if_);
 static void initd (void *f_name);
 static void __do_fork (void *);
+static void __do_spawn (void *);
+static void __do_vfork (void *);
+static bool argument_stack (const char *cmdline, size_t len, bool split,
+		struct intr_frame *if_);
+
+/* fork()하는 부모와 자식이 주고받는 정보. 부모 스택에 있다 */
+struct fork_info {
+	struct thread *parent;              /* 부모 */
+	struct intr_frame *if_;             /* 부모의 사용자 컨텍스트 */
+	bool success;                       /* 복제 성공 여부 */
+	struct semaphore done;              /* 자식이 복제를 마치면 올라간다 */
+};
+
+/* spawn()하는 부모와 자식이 주고받는 정보. 부모 스택에 있다 */
+struct spawn_info {
+	struct thread *parent;              /* 부모 */
+	const char *file;                   /* 실행할 파일 */
+	const char *args;                   /* '\0'으로 구분한 인자들 */
+	size_t len;                         /* ARGS의 길이 */
+	bool success;                       /* 로드 성공 여부 */
+	struct semaphore done;              /* 자식이 로드를 마치면 올라간다 */
+};
+
+/* vfork()한 부모와 자식이 주고받는 정보. 부모 스택에 있다 */
+struct vfork_info {
+	struct thread *parent;              /* 주소 공간을 빌려준 부모 */
+	struct intr_frame *if_;             /* 부모의 사용자 컨텍스트 */
+	struct semaphore done;              /* 주소 공간을 돌려주면 올라간다 */
+};
 
 /* General process initializer for initd and other process. */
 static void
@@ -80,42 +112,144 @@ initd (void *f_name) {
 	NOT_REACHED ();
 }
 
-struct thread *get_child_process(int pid)
+/* Clones the current process as `name`. Returns the new process's thread id, or
+ * TID_ERROR if the thread cannot be created. */
+tid_t process_fork(const char *name, struct intr_frame *if_ UNUSED)
 {
-    struct thread *cur = thread_current(); // 현재 스레드를 가져옵니다.
-    struct list *child_list = &cur->child_list; // 자식 스레드들을 저장하는 리스트를 가져옵니다.
+    struct fork_info info;
 
-    // 자식 리스트를 순회하며 원하는 PID를 가진 자식 스레드를 검색합니다.
-    for (struct list_elem *e = list_begin(child_list); e != list_end(child_list); e = list_next(e))
-    {
-        struct thread *t = list_entry(e, struct thread, child_elem);
-        if (t->tid == pid) // 자식 스레드의 TID가 찾고자 하는 PID와 일치하는 경우
-            return t; // 해당 자식 스레드를 반환합니다.
+    info.parent = thread_current();
+    info.if_ = if_;
+    info.success = false;
+    sema_init(&info.done, 0);
+
+    tid_t pid = thread_create(name, PRI_DEFAULT, __do_fork, &info); // 새로운 스레드를 생성하여 fork 작업을 수행합니다.
+    if (pid == TID_ERROR)
+        return TID_ERROR; // 새로운 스레드 생성에 실패한 경우, TID_ERROR를 반환합니다.
+
+    // 자식이 부모의 자원을 다 복제할 때까지 기다린다. 그 전에는 INFO가 부모 스택에 살아 있어야 한다
+    sema_down(&info.done);
+    if (!info.success) {
+        // 복제에 실패한 자식은 스스로 종료하므로 거둬 준다
+        process_wait(pid);
+        return TID_ERROR;
     }
+    return pid; // 생성한 자식 스레드의 TID를 반환합니다.
+}
 
-    return NULL; // 자식 스레드를 찾지 못한 경우 NULL을 반환합니다.
+
+// FILE을 새 주소 공간에 바로 로드해 실행하는 자식 프로세스를 만든다.
+// fork 후 exec와 달리 부모의 페이지 테이블을 복사했다가 버리는 일이 없다.
+// ARGS는 LEN 바이트에 걸쳐 '\0'으로 구분된 argv 문자열들이고, 자식은 부모의 FDT를 물려받는다.
+// 자식의 TID를 반환하고, 자식을 만들지 못했거나 로드에 실패하면 TID_ERROR를 반환한다
+tid_t process_spawn(const char *file, const char *args, size_t len)
+{
+    struct spawn_info info;
+
+    info.parent = thread_current();
+    info.file = file;
+    info.args = args;
+    info.len = len;
+    info.success = false;
+    sema_init(&info.done, 0);
+
+    tid_t pid = thread_create(file, PRI_DEFAULT, __do_spawn, &info);
+    if (pid == TID_ERROR)
+        return TID_ERROR;
+
+    // 자식이 로드를 마칠 때까지 기다린다. 그 전에는 INFO가 부모 스택에 살아 있어야 한다
+    sema_down(&info.done);
+    if (!info.success) {
+        // 로드에 실패한 자식은 스스로 종료하므로 거둬 준다
+        process_wait(pid);
+        return TID_ERROR;
+    }
+    return pid;
 }
 
-/* Clones the current process as `name`. Returns the new process's thread id, or
- * TID_ERROR if the thread cannot be created. */
-tid_t process_fork(const char *name, struct intr_frame *if_ UNUSED)
+// 부모의 주소 공간을 빌려 쓰는 자식 프로세스를 만든다. 페이지를 하나도 복사하지 않는다.
+// 자식이 exec하거나 종료해 주소 공간을 돌려줄 때까지 부모는 잠들어 있다.
+// 자식의 TID를 반환하고, 자식을 만들지 못하면 TID_ERROR를 반환한다
+tid_t process_vfork(const char *name, struct intr_frame *if_)
 {
-    struct thread *cur = thread_current(); // 현재 스레드를 가져옵니다.
+    struct vfork_info info;
 
-    // 현재 스레드의 parent_if에 if_가 가리키는 데이터를 복사합니다.
-    memcpy(&cur->parent_if, if_, sizeof(struct intr_frame));
+    info.parent = thread_current();
+    info.if_ = if_;
+    sema_init(&info.done, 0);
 
-    tid_t pid = thread_create(name, PRI_DEFAULT, __do_fork, cur); // 새로운 스레드를 생성하여 fork 작업을 수행합니다.
+    tid_t pid = thread_create(name, PRI_DEFAULT, __do_vfork, &info);
     if (pid == TID_ERROR)
-        return TID_ERROR; // 새로운 스레드 생성에 실패한 경우, TID_ERROR를 반환합니다.
+        return TID_ERROR;
 
-    struct thread *child = get_child_process(pid); // 생성한 자식 스레드를 가져옵니다.
+    sema_down(&info.done);
+    return pid;
+}
 
-    sema_down(&child->load_sema); // 자식 스레드가 load_sema를 획득할 때까지 대기합니다.
+/* A thread function that loads the program a parent spawn()s. */
+static void
+__do_spawn (void *aux) {
+	struct spawn_info *info = aux;
+	struct thread *current = thread_current ();
+	struct intr_frame if_;
+	bool success;
 
-    return pid; // 생성한 자식 스레드의 TID를 반환합니다.
+	memset (&if_, 0, sizeof if_);
+	if_.ds = if_.es = if_.ss = SEL_UDSEG;
+	if_.cs = SEL_UCSEG;
+	if_.eflags = FLAG_IF | FLAG_MBS;
+
+#ifdef VM
+	supplemental_page_table_init (&current->spt);
+#endif
+	current->fdt = fd_table_share (info->parent->fdt);
+	process_init ();
+
+	success = load (info->file, &if_)
+		&& argument_stack (info->args, info->len, false, &if_);
+
+	/* INFO is gone once the parent wakes up. */
+	info->success = success;
+	sema_up (&info->done);
+
+	if (success)
+		do_iret (&if_);
+	thread_exit ();
 }
 
+/* A thread function that takes over the address space of a parent
+ * that vfork()s, and returns to user mode in it. */
+static void
+__do_vfork (void *aux) {
+	struct vfork_info *info = aux;
+	struct thread *parent = info->parent;
+	struct thread *current = thread_current ();
+	struct intr_frame if_;
+
+	memcpy (&if_, info->if_, sizeof if_);
+	if_.R.rax = 0;
+
+	/* Move the address space over rather than share it: the parent
+	 * stays asleep until process_cleanup() moves it back, so it is
+	 * only ever in use by one thread. */
+	current->pml4 = parent->pml4;
+	current->pcid = parent->pcid;
+	parent->pml4 = NULL;
+#ifdef VM
+	current->spt = parent->spt;
+#endif
+	current->vfork = info;
+	process_activate (current);
+
+	/* The parent's FPU state must survive the child's use of the
+	 * FPU, so the child gets a copy of it rather than the registers. */
+	if (!fpu_copy (parent))
+		thread_exit ();
+
+	current->fdt = fd_table_share (parent->fdt);
+	process_init ();
+	do_iret (&if_);
+}
 
 #ifndef VM
 /* Duplicate the parent's address space by passing this function to the
@@ -139,14 +273,14 @@ duplicate_pte (uint64_t *pte, void *va, void *aux) {
 
     /* 3. TODO: Allocate new PAL_USER page for the child and set result to
      *    TODO: NEWPAGE. */
-    newpage = palloc_get_page(PAL_USER | PAL_ZERO);
+    newpage = palloc_get_page(PAL_USER);
     if (newpage == NULL)
         return false;
 
     /* 4. TODO: Duplicate parent's page to the new page and
      *    TODO: check whether parent's page is writable or not (set WRITABLE
      *    TODO: according to the result). */
-    memcpy(newpage, parent_page, PGSIZE);
+    copy_page(newpage, parent_page);
     writable = is_writable(pte);
 
     /* 5. Add new page to child's page table at address VA with WRITABLE
@@ -167,10 +301,11 @@ duplicate_pte (uint64_t *pte, void *va, void *aux) {
 static void
 __do_fork (void *aux) {
     struct intr_frame if_;
-    struct thread *parent = (struct thread *) aux;
+    struct fork_info *info = aux;
+    struct thread *parent = info->parent;
     struct thread *current = thread_current ();
     /* TODO: somehow pass the parent_if. (i.e. process_fork()'s if_) */
-    struct intr_frame *parent_if = &parent->parent_if;
+    struct intr_frame *parent_if = info->if_;
     bool succ = true;
 
     /* 1. Read the cpu context to local stack. */
@@ -192,42 +327,39 @@ __do_fork (void *aux) {
         goto error;
 #endif
 
+    // 부모의 FPU 레지스터도 사용자 상태이므로 복사한다
+    if (!fpu_copy (parent))
+        goto error;
+
     /* TODO: Your code goes here.
      * TODO: Hint) To duplicate the file object, use `file_duplicate`
      * TODO:       in include/filesys/file.h. Note that parent should not return
      * TODO:       from the fork() until this function successfully duplicates
      * TODO:       the resources of parent.*/
 
-    // FDT 복사
-    for (int i = 0; i < FDCOUNT_LIMIT; i++)
-    {
-        struct file *file = parent->fdt[i];
-        if (file == NULL)
-            continue;
-        if (file > 2)
-            file = file_duplicate(file); // 파일 객체를 복제하여 자식 프로세스의 FDT에 저장합니다.
-        current->fdt[i] = file; // 복제한 파일 객체를 자식 프로세스의 FDT에 할당합니다.
-    }
-    current->fdidx = parent->fdidx; // 자식 프로세스의 fdidx 값을 부모 프로세스의 fdidx 값으로 설정합니다.
-
-    // 로드가 완료될 때까지 기다리고 있던 부모 대기 해제
-    sema_up(&current->load_sema);
+    // FDT는 복사하지 않고 부모와 공유한다. 둘 중 하나가 fd를 쓰려 할 때 그쪽이 파일을 복제해 제 테이블을 갖는다
+    current->fdt = fd_table_share(parent->fdt);
 
     process_init();
 
+    // 복제가 끝나기를 기다리고 있던 부모 대기 해제. 이후로 INFO는 사라진다
+    info->success = succ;
+    sema_up(&info->done);
+
     /* Finally, switch to the newly created process. */
     if (succ)
         do_iret (&if_);
 
 error:
-    sema_up(&current->load_sema);
+    info->success = false;
+    sema_up(&info->done);
     exit(TID_ERROR);
 }
 
 /* Switch the current execution context to the f_name.
  * Returns -1 on fail. */
 int process_exec(void *f_name) {
-    char *file_name = f_name;
+    char *cmdline = f_name;
     bool success;
 
     struct intr_frame _if;
@@ -235,79 +367,77 @@ int process_exec(void *f_name) {
     _if.cs = SEL_UCSEG;
     _if.eflags = FLAG_IF | FLAG_MBS;
 
-    // 기존 실행 컨텍스트 정리
+    // 기존 실행 컨텍스트 정리. 새 프로그램은 FPU도 초기 상태에서 시작한다
     process_cleanup();
-
-    // 인자 파싱
-    char *argv[64];
-    int argc = 0;
-    char *token, *save_ptr;
-    for (token = strtok_r(file_name, " ", &save_ptr); token != NULL;
-         token = strtok_r(NULL, " ", &save_ptr)) {
-        argv[argc++] = token;
-    }
-
-    // 첫 번째 토큰이 실행 파일명
-    success = load(argv[0], &_if);
-    if (!success) {
-        palloc_free_page(file_name);
+    fpu_reset();
+
+    // 첫 번째 단어가 실행 파일명. 잠시 '\0'으로 끊어 load에 넘기고 되돌린다
+    char *name = cmdline + strspn(cmdline, " ");
+    size_t name_len = strcspn(name, " ");
+    char saved = name[name_len];
+    name[name_len] = '\0';
+    success = load(name, &_if);
+    name[name_len] = saved;
+
+    // argument stack 구성 (rdi, rsi도 여기서 설정)
+    if (success)
+        success = argument_stack(cmdline, strlen(cmdline) + 1, true, &_if);
+
+    palloc_free_page(cmdline);
+    if (!success)
         return -1;
-    }
-
-    // rsp 초기화 (PHYS_BASE 대신 0x8040000 사용)
-    _if.rsp = (void *)USER_STACK;
-
-    // argument stack 구성
-    argument_stack(argv, argc, &_if.rsp);
 
-    // rdi, rsi 설정 (argc, argv)
-    _if.R.rdi = argc;
-    _if.R.rsi = (uint64_t)(_if.rsp + sizeof(void *)); 
-
-	
-
-    palloc_free_page(file_name);
-	hex_dump(_if.rsp, _if.rsp, USER_STACK - (uint64_t)_if.rsp, true); //임시시
     do_iret(&_if);
 
     NOT_REACHED();
 }
 
-void argument_stack(char **argv, int argc, void **rsp) {
-    char *arg_addr[128];  // 인자 최대 개수, 필요시 크기 조절
-
-    // 1. 인자 문자열들을 역순으로 복사
-    for (int i = argc - 1; i >= 0; i--) {
-        int len = strlen(argv[i]) + 1; // '\0' 포함
-        *rsp -= len;
-        memcpy(*rsp, argv[i], len);
-        arg_addr[i] = *rsp;  // 복사한 문자열의 주소 저장
-    }
+// LEN 바이트의 인자 문자열 CMDLINE을 사용자 스택에 올리고 rdi(argc), rsi(argv)를 설정한다.
+// 인자는 '\0'으로 구분되고, SPLIT이면 공백으로도 구분된다 (exec의 명령줄).
+// CMDLINE을 스택 맨 위에 한 번 복사하면서 그 자리에서 구분자를 '\0'으로 바꿔 단어를 나누고,
+// 단어를 찾는 즉시 그 주소를 argv 자리에 적으므로 인자는 한 번만 훑는다.
+// 인자가 스택 한 페이지에 들어가지 않으면 false를 반환
+static bool argument_stack(const char *cmdline, size_t len, bool split, struct intr_frame *if_) {
+    uint8_t *stack_bottom = (uint8_t *) USER_STACK - PGSIZE;
+    char *args = (char *) USER_STACK - len;
+    char **argv;
+    int argc = 0;
+    bool in_word = false;
 
-    // 2. 스택 8바이트 정렬 (word-align)
-    uintptr_t padding = (uintptr_t)(*rsp) % 8;
-    if (padding > 0) {
-        *rsp -= padding;
-        memset(*rsp, 0, padding);
+    // 문자열 바로 아래(8바이트 정렬)가 argv[argc] = NULL, 그 아래로 argv 포인터들이 쌓인다
+    if (len > PGSIZE - 2 * sizeof(void *))
+        return false;
+    argv = (char **) ((uintptr_t) args & ~(uintptr_t) 7) - 1;
+    *argv = NULL;
+
+    for (size_t i = 0; i < len; i++) {
+        char c = split && cmdline[i] == ' ' ? '\0' : cmdline[i];
+
+        args[i] = c;
+        if (c != '\0' && !in_word) {
+            // 단어 시작. argv 한 칸과 가짜 반환 주소 한 칸이 더 들어갈 자리가 있어야 한다
+            if ((uint8_t *) (argv - 2) < stack_bottom)
+                return false;
+            *--argv = &args[i];
+            argc++;
+        }
+        in_word = c != '\0';
     }
 
-    // 3. NULL sentinel (argv[argc] = NULL)
-    *rsp -= sizeof(char *);
-    *(char **)(*rsp) = NULL;
-
-    // 4. 인자 문자열 주소들을 역순으로 push (argv[0] ~ argv[argc-1])
-    for (int i = argc - 1; i >= 0; i--) {
-        *rsp -= sizeof(char *);
-        *(char **)(*rsp) = arg_addr[i];
+    // 찾은 순서대로 아래로 쌓였으므로 뒤집어서 argv[0]이 가장 낮은 주소에 오게 한다
+    for (int i = 0; i < argc / 2; i++) {
+        char *tmp = argv[i];
+        argv[i] = argv[argc - 1 - i];
+        argv[argc - 1 - i] = tmp;
     }
 
-    // 5. rsi에서 사용할 argv 주소 저장
-    //    rsp는 현재 fake return address 위치 → 그 위가 argv[0] 주소
-    //    (이 부분은 process_exec에서 따로 처리)
+    // fake return address
+    if_->rsp = (uint64_t) (argv - 1);
+    *(void **) if_->rsp = NULL;
 
-    // 6. fake return address
-    *rsp -= sizeof(void *);
-    *(void **)(*rsp) = NULL;
+    if_->R.rdi = argc;
+    if_->R.rsi = (uint64_t) argv;
+    return true;
 }
 
 
@@ -326,17 +456,15 @@ process_wait(tid_t child_tid UNUSED) {
      * XXX:       to add infinite loop here before
      * XXX:       implementing the process_wait. */
 
-    struct thread *child = get_child_process(child_tid);
-    if (child == NULL)
-        return -1;
-
-    sema_down(&child->wait_sema); // 자식 스레드가 종료될 때까지 대기합니다.
-
-    list_remove(&child->child_elem); // 자식 스레드를 자식 리스트에서 제거합니다.
-
-    sema_up(&child->exit_sema); // 자식 스레드의 종료를 알리기 위해 exit_sema를 올립니다.
+    // 자식의 종료 상태는 struct thread와 따로 보관되므로 자식 스레드가 이미 사라졌어도 된다
+    return child_wait(child_tid);
+}
 
-    return child->exit_status; // 자식 스레드의 종료 상태를 반환합니다.
+// 아무 자식이나 종료되기를 기다려 그 TID를 반환하고 종료 상태를 *STATUS에 저장한다.
+// 이미 종료된 자식이 있으면 먼저 종료된 순서대로 바로 거둔다. 기다릴 자식이 없으면 -1을 반환한다
+tid_t
+process_wait_any(int *status) {
+    return child_wait_any(status);
 }
 
 /* Exit the process. This function is called by thread_exit (). */
@@ -348,12 +476,9 @@ process_exit(void) {
      * TODO: project2/process_termination.html).
      * TODO: We recommend you to implement process resource cleanup here. */
 
-    // 파일 디스크립터 닫기
-    for (int i = 2; i < FDCOUNT_LIMIT; i++)
-        close(i);
-
-    // 파일 디스크립터 테이블 해제
-    palloc_free_multiple(t->fdt, FDT_PAGES);
+    // 파일 디스크립터 테이블 해제. 공유하는 프로세스가 더 없으면 열린 파일도 모두 닫힌다
+    fd_table_release(t->fdt);
+    t->fdt = NULL;
 
     // 실행 중인 파일 닫기
     file_close(t->running);
@@ -361,11 +486,11 @@ process_exit(void) {
     // 프로세스 정리
     process_cleanup();
 
-    // 부모 스레드가 자식 스레드의 종료를 확인할 수 있도록 wait_sema를 올립니다.
-    sema_up(&t->wait_sema);
+    // 아직 실행 중인 자식들은 종료 상태를 스스로 정리하도록 놓아준다
+    child_release_all();
 
-    // 자식 스레드가 종료될 때까지 대기합니다.
-    sema_down(&t->exit_sema);
+    // 부모에게 종료 상태를 남긴다. 스레드 페이지는 부모의 wait를 기다리지 않고 바로 해제된다
+    child_exit(t->exit_status);
 }
 
 /* Free the current process's resources. */
@@ -373,6 +498,25 @@ static void
 process_cleanup (void) {
 	struct thread *curr = thread_current ();
 
+	/* A vfork() child gives the address space back to its parent
+	 * instead of destroying it, and lets the parent run again. */
+	if (curr->vfork != NULL) {
+		struct vfork_info *info = curr->vfork;
+		struct thread *parent = info->parent;
+
+		parent->pcid = curr->pcid;
+#ifdef VM
+		parent->spt = curr->spt;
+		supplemental_page_table_init (&curr->spt);
+#endif
+		parent->pml4 = curr->pml4;
+		curr->pml4 = NULL;
+		pml4_activate (NULL);
+		curr->vfork = NULL;
+		sema_up (&info->done);
+		return;
+	}
+
 #ifdef VM
 	supplemental_page_table_kill (&curr->spt);
 #endif
@@ -400,7 +544,7 @@ process_cleanup (void) {
 void
 process_activate (struct thread *next) {
 	/* Activate thread's page tables. */
-	pml4_activate (next->pml4);
+	pml4_activate_tagged (next->pml4, &next->pcid);
 
 	/* Set thread's kernel stack for use in processing interrupts. */
 	tss_update (next);
@@ -465,57 +609,63 @@ static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		uint32_t read_bytes, uint32_t zero_bytes,
 		bool writable);
 
-/* Loads an ELF executable from FILE_NAME into the current thread.
- * Stores the executable's entry point into *RIP
- * and its initial stack pointer into *RSP.
- * Returns true if successful, false otherwise. */
-static bool
-load (const char *file_name, struct intr_frame *if_) {
-	struct thread *t = thread_current ();
+/* Validated headers of an executable, attached to its inode (see
+ * inode_set_aux()) so that executing it again skips reading and
+ * checking them.  Dropped when the file is written to or closed by
+ * its last opener. */
+struct elf_info {
+	uint64_t entry;             /* Entry point. */
+	int load_cnt;               /* Number of elements in LOAD. */
+	struct Phdr load[];         /* PT_LOAD segments, in file order. */
+};
+
+/* Frees INFO, a struct elf_info. */
+static void
+elf_info_destroy (void *info) {
+	free (info);
+}
+
+/* Returns the validated headers of executable FILE, reading them if
+ * they are not cached on its inode yet.  Returns a null pointer if
+ * FILE is not an executable we can load or memory runs out. */
+static const struct elf_info *
+elf_info_get (struct file *file) {
+	struct inode *inode = file_get_inode (file);
+	struct elf_info *info = inode_get_aux (inode, elf_info_destroy);
 	struct ELF ehdr;
-	struct file *file = NULL;
-	off_t file_ofs;
-	bool success = false;
+	size_t phdrs_size;
 	int i;
 
-	/* Allocate and activate page directory. */
-	t->pml4 = pml4_create ();
-	if (t->pml4 == NULL)
-		goto done;
-	process_activate (thread_current ());
-
-	/* Open executable file. */
-	file = filesys_open (file_name);
-	if (file == NULL) {
-		printf ("load: %s: open failed\n", file_name);
-		goto done;
-	}
+	if (info != NULL)
+		return info;
 
 	/* Read and verify executable header. */
-	if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
+	if (file_read_at (file, &ehdr, sizeof ehdr, 0) != sizeof ehdr
 			|| memcmp (ehdr.e_ident, "\177ELF\2\1\1", 7)
 			|| ehdr.e_type != 2
 			|| ehdr.e_machine != 0x3E // amd64
 			|| ehdr.e_version != 1
 			|| ehdr.e_phentsize != sizeof (struct Phdr)
-			|| ehdr.e_phnum > 1024) {
-		printf ("load: %s: error loading executable\n", file_name);
-		goto done;
-	}
-
-	/* Read program headers. */
-	file_ofs = ehdr.e_phoff;
+			|| ehdr.e_phnum > 1024
+			|| ehdr.e_phoff > (uint64_t) file_length (file))
+		return NULL;
+
+	/* Read all the program headers at once, then keep only the
+	 * loadable ones. */
+	phdrs_size = ehdr.e_phnum * sizeof (struct Phdr);
+	info = malloc (sizeof *info + phdrs_size);
+	if (info == NULL)
+		return NULL;
+	if (file_read_at (file, info->load, phdrs_size, ehdr.e_phoff)
+			!= (off_t) phdrs_size)
+		goto fail;
+
+	info->entry = ehdr.e_entry;
+	info->load_cnt = 0;
 	for (i = 0; i < ehdr.e_phnum; i++) {
-		struct Phdr phdr;
-
-		if (file_ofs < 0 || file_ofs > file_length (file))
-			goto done;
-		file_seek (file, file_ofs);
+		struct Phdr *phdr = &info->load[i];
 
-		if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
-			goto done;
-		file_ofs += sizeof phdr;
-		switch (phdr.p_type) {
+		switch (phdr->p_type) {
 			case PT_NULL:
 			case PT_NOTE:
 			case PT_PHDR:
@@ -526,56 +676,102 @@ load (const char *file_name, struct intr_frame *if_) {
 			case PT_DYNAMIC:
 			case PT_INTERP:
 			case PT_SHLIB:
-				goto done;
+				goto fail;
 			case PT_LOAD:
-				if (validate_segment (&phdr, file)) {
-					bool writable = (phdr.p_flags & PF_W) != 0;
-					uint64_t file_page = phdr.p_offset & ~PGMASK;
-					uint64_t mem_page = phdr.p_vaddr & ~PGMASK;
-					uint64_t page_offset = phdr.p_vaddr & PGMASK;
-					uint32_t read_bytes, zero_bytes;
-					if (phdr.p_filesz > 0) {
-						/* Normal segment.
-						 * Read initial part from disk and zero the rest. */
-						read_bytes = page_offset + phdr.p_filesz;
-						zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
-								- read_bytes);
-					} else {
-						/* Entirely zero.
-						 * Don't read anything from disk. */
-						read_bytes = 0;
-						zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
-					}
-					if (!load_segment (file, file_page, (void *) mem_page,
-								read_bytes, zero_bytes, writable))
-						goto done;
-				}
-				else
-					goto done;
+				if (!validate_segment (phdr, file))
+					goto fail;
+				info->load[info->load_cnt++] = *phdr;
 				break;
 		}
 	}
 
+	inode_set_aux (inode, info, elf_info_destroy);
+	return info;
 
-	t->running = file; // 현재 스레드의 실행 중인 파일을 설정합니다.
+fail:
+	free (info);
+	return NULL;
+}
 
-    file_deny_write(file); // 파일에 대한 쓰기 권한을 거부합니다.
+/* Loads an ELF executable from FILE_NAME into the current thread.
+ * Stores the executable's entry point into *RIP
+ * and its initial stack pointer into *RSP.
+ * Returns true if successful, false otherwise. */
+static bool
+load (const char *file_name, struct intr_frame *if_) {
+	struct thread *t = thread_current ();
+	const struct elf_info *info;
+	struct file *file = NULL;
+	bool success = false;
+	int i;
+
+	/* Allocate and activate page directory. */
+	t->pml4 = pml4_create ();
+	if (t->pml4 == NULL)
+		return false;
+	process_activate (thread_current ());
+
+	/* The headers cached on the inode must not change under us. */
+	lock_acquire (&filesys_lock);
+
+	/* Open executable file. */
+	file = filesys_open (file_name);
+	if (file == NULL) {
+		printf ("load: %s: open failed\n", file_name);
+		goto done;
+	}
+
+	/* Get the validated headers. */
+	info = elf_info_get (file);
+	if (info == NULL) {
+		printf ("load: %s: error loading executable\n", file_name);
+		goto done;
+	}
+
+	for (i = 0; i < info->load_cnt; i++) {
+		const struct Phdr *phdr = &info->load[i];
+		bool writable = (phdr->p_flags & PF_W) != 0;
+		uint64_t file_page = phdr->p_offset & ~PGMASK;
+		uint64_t mem_page = phdr->p_vaddr & ~PGMASK;
+		uint64_t page_offset = phdr->p_vaddr & PGMASK;
+		uint32_t read_bytes, zero_bytes;
+		if (phdr->p_filesz > 0) {
+			/* Normal segment.
+			 * Read initial part from disk and zero the rest. */
+			read_bytes = page_offset + phdr->p_filesz;
+			zero_bytes = (ROUND_UP (page_offset + phdr->p_memsz, PGSIZE)
+					- read_bytes);
+		} else {
+			/* Entirely zero.
+			 * Don't read anything from disk. */
+			read_bytes = 0;
+			zero_bytes = ROUND_UP (page_offset + phdr->p_memsz, PGSIZE);
+		}
+		if (!load_segment (file, file_page, (void *) mem_page,
+					read_bytes, zero_bytes, writable))
+			goto done;
+	}
 
 	/* Set up stack. */
 	if (!setup_stack (if_))
 		goto done;
 
 	/* Start address. */
-	if_->rip = ehdr.e_entry;
+	if_->rip = info->entry;
 
-	/* TODO: Your code goes here.
-	 * TODO: Implement argument passing (see project2/argument_passing.html). */
+	/* Keep the executable open, and unwritable, while it runs.  It
+	 * replaces the one this process was running before, if any. */
+	file_deny_write (file);
+	file_close (t->running);
+	t->running = file;
+	file = NULL;
 
 	success = true;
 
 done:
 	/* We arrive here whether the load is successful or not. */
 	file_close (file);
+	lock_release (&filesys_lock);
 	return success;
 }
 
@@ -728,11 +924,22 @@ install_page (void *upage, void *kpage, bool writable) {
  * If you want to implement the function for only project 2, implement it on the
  * upper block. */
 
+/* Reads the contents of PAGE as described by AUX, a struct lazy_load_aux,
+ * and releases AUX.  On a short read AUX is kept, for the page stays
+ * unloaded and a later fault reads it again. */
 static bool
-lazy_load_segment (struct page *page, void *aux) {
-	/* TODO: Load the segment from the file */
-	/* TODO: This called when the first page fault occurs on address VA. */
-	/* TODO: VA is available when calling this function. */
+lazy_load_segment (struct page *page, void *aux_) {
+	struct lazy_load_aux *aux = aux_;
+	uint8_t *kva = page->frame->kva;
+
+	if (file_read_at (aux->file, kva, aux->read_bytes, aux->ofs)
+			!= (off_t) aux->read_bytes)
+		return false;
+	memset (kva + aux->read_bytes, 0, PGSIZE - aux->read_bytes);
+
+	file_close (aux->file);
+	free (aux);
+	return true;
 }
 
 /* Loads a segment starting at offset OFS in FILE at address
@@ -763,16 +970,28 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		void *aux = NULL;
-		if (!vm_alloc_page_with_initializer (VM_ANON, upage,
-					writable, lazy_load_segment, aux))
+		/* Each page holds its own reference to FILE, so it can be
+		 * loaded (or read ahead) after the executable is closed. */
+		struct lazy_load_aux *aux = malloc (sizeof *aux);
+		if (aux == NULL)
 			return false;
+		aux->file = file_reopen (file);
+		aux->ofs = ofs;
+		aux->read_bytes = page_read_bytes;
+		aux->map_pages = 0;
+		if (aux->file == NULL
+				|| !vm_alloc_page_with_initializer (VM_ANON | VM_FILE_AUX,
+					upage, writable, lazy_load_segment, aux)) {
+			file_close (aux->file);
+			free (aux);
+			return false;
+		}
 
 		/* Advance. */
 		read_bytes -= page_read_bytes;
 		zero_bytes -= page_zero_bytes;
 		upage += PGSIZE;
+		ofs += page_read_bytes;
 	}
 	return true;
 }
@@ -783,11 +1002,12 @@ setup_stack (struct intr_frame *if_) {
 	bool success = false;
 	void *stack_bottom = (void *) (((uint8_t *) USER_STACK) - PGSIZE);
 
-	/* TODO: Map the stack on stack_bottom and claim the page immediately.
-	 * TODO: If success, set the rsp accordingly.
-	 * TODO: You should mark the page is stack. */
-	/* TODO: Your code goes here */
-
+	if (vm_alloc_page (VM_ANON | VM_STACK, stack_bottom, true)
+			&& vm_claim_page (stack_bottom)) {
+		thread_current ()->spt.stack_bottom = stack_bottom;
+		if_->rsp = USER_STACK;
+		success = true;
+	}
 	return success;
 }
 #endif /* VM */
@@ -3,22 +3,31 @@
 #include "threads/palloc.h"
 #include "filesys/filesys.h"
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #include "threads/loader.h"
 #include "userprog/gdt.h"
 #include "threads/flags.h"
 #include "intrinsic.h"
-#ifndef STDIN_FILENO
-#define STDIN_FILENO 0
-#define STDOUT_FILENO 1
-#endif
-#define FDCOUNT_LIMIT 128
+#include "userprog/uaccess.h"
+#include "userprog/fdtable.h"
+#include "userprog/pipe.h"
+#include "userprog/process.h"
+#include <iovec.h>
+#include <io_ring.h>
+#include <sysstat.h>
+#include <time.h>
+#include "devices/timer.h"
 
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
-void check_address(void* addr);
+static char *copy_in_string(const char *ustr);
+static int simple_io(int fd, void *buffer, unsigned size, bool is_write);
+static unsigned transfer_user(struct file *f, void *ubuf, unsigned size,
+                              off_t ofs, bool is_write, char *kbuf, bool *fault);
 
 /* System call
  *
@@ -52,58 +61,150 @@ syscall_init (void) {
 //syscall_handler를 호출할 때 인자 값 수에 맞게 인자 넣어주기.
 //순서는 rdi, rsi, rdx 순서대로 인자 값을 넣어주는 것이고 특별한 값이 있는게 아니다.
 /* The main system call interface */
-void syscall_handler (struct intr_frame *f UNUSED) {
-    int sys_number = f->R.rax;
+// 시스템 콜 번호마다 인자를 intr_frame에서 꺼내 해당 함수를 부르고 반환값을 rax에 넣는 함수들
+static void sys_halt(struct intr_frame *f UNUSED) { halt(); }
+static void sys_exit(struct intr_frame *f) { exit(f->R.rdi); }
+static void sys_fork(struct intr_frame *f) { f->R.rax = fork((const char *) f->R.rdi, f); }
+static void sys_exec(struct intr_frame *f) { f->R.rax = exec((const char *) f->R.rdi); }
+static void sys_spawn(struct intr_frame *f) { f->R.rax = spawn((const char *) f->R.rdi, (char *const *) f->R.rsi); }
+static void sys_vfork(struct intr_frame *f) { f->R.rax = vfork((const char *) f->R.rdi, f); }
+static void sys_wait(struct intr_frame *f) { f->R.rax = wait(f->R.rdi); }
+static void sys_wait_any(struct intr_frame *f) { f->R.rax = wait_any((int *) f->R.rdi); }
+static void sys_create(struct intr_frame *f) { f->R.rax = create((const char *) f->R.rdi, f->R.rsi); }
+static void sys_remove(struct intr_frame *f) { f->R.rax = remove((const char *) f->R.rdi); }
+static void sys_open(struct intr_frame *f) { f->R.rax = open((const char *) f->R.rdi); }
+static void sys_filesize(struct intr_frame *f) { f->R.rax = filesize(f->R.rdi); }
+static void sys_read(struct intr_frame *f) { f->R.rax = read(f->R.rdi, (void *) f->R.rsi, f->R.rdx); }
+static void sys_write(struct intr_frame *f) { f->R.rax = write(f->R.rdi, (const void *) f->R.rsi, f->R.rdx); }
+static void sys_seek(struct intr_frame *f) { seek(f->R.rdi, f->R.rsi); }
+static void sys_tell(struct intr_frame *f) { f->R.rax = tell(f->R.rdi); }
+static void sys_close(struct intr_frame *f) { close(f->R.rdi); }
+static void sys_dup2(struct intr_frame *f) { f->R.rax = dup2(f->R.rdi, f->R.rsi); }
+static void sys_pipe(struct intr_frame *f) { f->R.rax = pipe((int *) f->R.rdi); }
+static void sys_readv(struct intr_frame *f) { f->R.rax = readv(f->R.rdi, (const struct iovec *) f->R.rsi, f->R.rdx); }
+static void sys_writev(struct intr_frame *f) { f->R.rax = writev(f->R.rdi, (const struct iovec *) f->R.rsi, f->R.rdx); }
+static void sys_pread(struct intr_frame *f) { f->R.rax = pread(f->R.rdi, (void *) f->R.rsi, f->R.rdx, f->R.r10); }
+static void sys_pwrite(struct intr_frame *f) { f->R.rax = pwrite(f->R.rdi, (const void *) f->R.rsi, f->R.rdx, f->R.r10); }
+static void sys_sysstat(struct intr_frame *f) { f->R.rax = sysstat(f->R.rdi, (struct sysstat *) f->R.rsi); }
+static void sys_clock_gettime(struct intr_frame *f) { f->R.rax = clock_gettime(f->R.rdi, (struct timespec *) f->R.rsi); }
+static void sys_intrstat(struct intr_frame *f) { f->R.rax = intrstat(f->R.rdi, (struct intrstat *) f->R.rsi); }
+#ifdef VM
+static void sys_mmap(struct intr_frame *f) { f->R.rax = (uint64_t) mmap((void *) f->R.rdi, f->R.rsi, f->R.rdx, f->R.r10, f->R.r8); }
+static void sys_munmap(struct intr_frame *f) { munmap((void *) f->R.rdi); }
+static void sys_io_setup(struct intr_frame *f) { f->R.rax = (uint64_t) io_setup(); }
+static void sys_io_enter(struct intr_frame *f) { f->R.rax = io_enter(f->R.rdi); }
+#endif
 
-    switch (sys_number)
-    {
-        case SYS_HALT:
-            halt();
-            break;
-        case SYS_EXIT:
-            exit(f->R.rdi);
-            break;
-        case SYS_FORK:
-			f->R.rax = fork((const char *)f->R.rdi, f);  // 반환값 필요
-            break;
-        case SYS_WAIT:
-            f->R.rax = wait(f->R.rdi);  // 반환값 필요
-            break;
-        case SYS_CREATE:
-            f->R.rax = create(f->R.rdi, f->R.rsi);
-            break;
-        case SYS_REMOVE:
-            f->R.rax = remove(f->R.rdi);
-            break;
-        case SYS_OPEN:
-            f->R.rax = open(f->R.rdi);
-            break;
-        case SYS_FILESIZE:
-            f->R.rax = filesize(f->R.rdi);
-            break;
-        case SYS_READ:
-            f->R.rax = read(f->R.rdi, f->R.rsi, f->R.rdx);
-            break;
-        case SYS_WRITE:
-            f->R.rax = write(f->R.rdi, f->R.rsi, f->R.rdx);
-            break;
-        case SYS_SEEK:
-            seek(f->R.rdi, f->R.rsi);  // void
-            break;
-        case SYS_TELL:
-            f->R.rax = tell(f->R.rdi);
-            break;
-        case SYS_CLOSE:
-            close(f->R.rdi);
-            break;
-        default:
-            thread_exit();
-    }
+// 시스템 콜 번호(include/lib/syscall-nr.h의 SYS_*)로 찾는 분배 표.
+// 비어 있는 칸은 이 커널에서 지원하지 않는 시스템 콜이다
+static const struct syscall_desc {
+    void (*func)(struct intr_frame *);  // 처리 함수
+    const char *name;                   // 통계 출력용 이름
+} syscall_table[] = {
+    [SYS_HALT] = {sys_halt, "halt"},
+    [SYS_EXIT] = {sys_exit, "exit"},
+    [SYS_FORK] = {sys_fork, "fork"},
+    [SYS_EXEC] = {sys_exec, "exec"},
+    [SYS_WAIT] = {sys_wait, "wait"},
+    [SYS_CREATE] = {sys_create, "create"},
+    [SYS_REMOVE] = {sys_remove, "remove"},
+    [SYS_OPEN] = {sys_open, "open"},
+    [SYS_FILESIZE] = {sys_filesize, "filesize"},
+    [SYS_READ] = {sys_read, "read"},
+    [SYS_WRITE] = {sys_write, "write"},
+    [SYS_SEEK] = {sys_seek, "seek"},
+    [SYS_TELL] = {sys_tell, "tell"},
+    [SYS_CLOSE] = {sys_close, "close"},
+    [SYS_DUP2] = {sys_dup2, "dup2"},
+#ifdef VM
+    [SYS_MMAP] = {sys_mmap, "mmap"},
+    [SYS_MUNMAP] = {sys_munmap, "munmap"},
+    [SYS_IO_SETUP] = {sys_io_setup, "io_setup"},
+    [SYS_IO_ENTER] = {sys_io_enter, "io_enter"},
+#endif
+    [SYS_READV] = {sys_readv, "readv"},
+    [SYS_WRITEV] = {sys_writev, "writev"},
+    [SYS_PREAD] = {sys_pread, "pread"},
+    [SYS_PWRITE] = {sys_pwrite, "pwrite"},
+    [SYS_SYSSTAT] = {sys_sysstat, "sysstat"},
+    [SYS_PIPE] = {sys_pipe, "pipe"},
+    [SYS_SPAWN] = {sys_spawn, "spawn"},
+    [SYS_VFORK] = {sys_vfork, "vfork"},
+    [SYS_WAIT_ANY] = {sys_wait_any, "wait_any"},
+    [SYS_CLOCK_GETTIME] = {sys_clock_gettime, "clock_gettime"},
+    [SYS_INTRSTAT] = {sys_intrstat, "intrstat"},
+};
+
+#define SYSCALL_CNT (sizeof syscall_table / sizeof *syscall_table)
+
+// 시스템 콜별 호출 횟수와 처리에 걸린 TSC cycle 합
+static struct sysstat syscall_stats[SYSCALL_CNT];
+
+void syscall_handler (struct intr_frame *f) {
+    uint64_t sys_number = f->R.rax;
+
+    /* 커널 안에서 난 page fault의 stack growth 판단에 쓰는 user rsp */
+    thread_current()->user_rsp = f->rsp;
+
+    // 범위를 벗어나거나 지원하지 않는 번호면 프로세스를 종료
+    if (sys_number >= SYSCALL_CNT || syscall_table[sys_number].func == NULL)
+        exit(-1);
+
+    // exit처럼 돌아오지 않는 시스템 콜도 있으므로 횟수는 먼저 센다
+    struct sysstat *st = &syscall_stats[sys_number];
+    uint64_t start = rdtsc();
+    st->calls++;
+    TRACE(TRACE_SYSCALL, sys_number, f->R.rdi);
+    syscall_table[sys_number].func(f);
+    TRACE(TRACE_SYSCALL_DONE, sys_number, f->R.rax);
+    st->cycles += rdtsc() - start;
 
     // 디버깅용 로그
     // printf ("system call number: %d\n", sys_number);
 }
 
+// 시스템 콜 nr의 통계를 사용자 버퍼 st에 복사하는 시스템 콜. nr이 잘못되면 -1
+int sysstat(int nr, struct sysstat *st) {
+    if (nr < 0 || (unsigned) nr >= SYSCALL_CNT || syscall_table[nr].func == NULL)
+        return -1;
+    if (!copy_to_user(st, &syscall_stats[nr], sizeof *st))
+        exit(-1);
+    return 0;
+}
+
+// clock이 가리키는 시계의 현재 시각을 사용자 버퍼 ts에 복사하는 시스템 콜.
+// 부팅 이후 시간(CLOCK_MONOTONIC)만 지원하며, 다른 시계면 -1
+int clock_gettime(int clock, struct timespec *ts) {
+    if (clock != CLOCK_MONOTONIC)
+        return -1;
+
+    int64_t now = timer_now_ns();
+    struct timespec kts = {now / 1000000000, now % 1000000000};
+    if (!copy_to_user(ts, &kts, sizeof kts))
+        exit(-1);
+    return 0;
+}
+
+// 인터럽트 vec의 통계를 사용자 버퍼 st에 복사하는 시스템 콜.
+// vec이 INTRSTAT_OFF면 인터럽트를 끈 구간의 통계를, 잘못된 vec이면 -1
+int intrstat(int vec, struct intrstat *st) {
+    struct intrstat kst;
+    if (!intr_get_stats(vec, &kst))
+        return -1;
+    if (!copy_to_user(st, &kst, sizeof kst))
+        exit(-1);
+    return 0;
+}
+
+/* Prints system call statistics. */
+void
+syscall_print_stats (void) {
+    for (unsigned i = 0; i < SYSCALL_CNT; i++)
+        if (syscall_stats[i].calls > 0)
+            printf ("Syscall: %s %lld calls, %llu cycles\n", syscall_table[i].name,
+                    syscall_stats[i].calls, syscall_stats[i].cycles);
+}
+
 
 //함수 호출 시 핀토스를 종료시키는 시스템 콜
 void halt(void){
@@ -130,9 +231,11 @@ void exit(int status){
 bool 
 create(const char *file, unsigned initial_size) 
 {
-    check_address(file);
+    char *kfile = copy_in_string(file);
+    bool success = filesys_create(kfile, initial_size);
 
-    return filesys_create(file, initial_size);
+    palloc_free_page(kfile);
+    return success;
 }
 
 
@@ -141,81 +244,43 @@ create(const char *file, unsigned initial_size)
 bool 
 remove(const char *file) 
 {
-    check_address(file);
+    char *kfile = copy_in_string(file);
+    bool success = filesys_remove(kfile);
 
-    return filesys_remove(file);
+    palloc_free_page(kfile);
+    return success;
 }
 
 
 int write(int fd, const void *buffer, unsigned size) {
-    check_address(buffer);
-    struct file *f = process_get_file(fd);
-    /* 실행된 후 쓰여진 바이트 수를 저장하는 변수 */
-    int bytes_written = 0;
-
-    lock_acquire(&filesys_lock);
-
-    if (fd == STDOUT_FILENO) {
-        /* 쓰기가 표준 출력인 경우, 버퍼의 내용을 화면에 출력하고 쓰여진 바이트 수를 저장 */
-        putbuf(buffer, size);
-        bytes_written = size;
-    } else if (fd == STDIN_FILENO) {
-        /* 쓰기가 표준 입력인 경우, 파일 시스템 잠금 해제 후 -1 반환 */
-        lock_release(&filesys_lock);
-        return -1;
-    } else if (fd >= 2) {
-        if (f == NULL) {
-            /* 쓰기가 파일에 대한 것인데 파일이 없는 경우, 파일 시스템 잠금 해제 후 -1 반환 */
-            lock_release(&filesys_lock);
-            return -1;
-        }
-        /* 파일에 버퍼의 내용을 쓰고 쓰여진 바이트 수를 저장 */
-        bytes_written = file_write(f, buffer, size);
-    }
-
-    lock_release(&filesys_lock);
-
-    return bytes_written;
+    /* fd가 가리키는 대상(화면, 파일, 파이프)에 쓰고 쓰여진 바이트 수를 반환 */
+    return simple_io(fd, (void *) buffer, size, true);
 }
 
 
 int open (const char *file) {
-    check_address(file);  // 주소 유효성 검사
+    char *kfile = copy_in_string(file);  // 파일 이름을 커널로 복사 (잘못된 주소면 종료)
 
-    struct file *f = filesys_open(file);  // 파일 시스템에서 파일 열기
+    struct file *f = filesys_open(kfile);  // 파일 시스템에서 파일 열기
+    palloc_free_page(kfile);
 
-    if (file == NULL) {
+    if (f == NULL) {
         return -1;  // 파일 열기 실패 시 -1 반환
     }
 
-    int fd = process_add_file(file);  // 파일을 프로세스에 추가하고 파일 디스크립터 얻기
+    int fd = process_add_file(f);  // 파일을 프로세스에 추가하고 파일 디스크립터 얻기
 
     if (fd == -1) {
-        file_close(file);  // 파일 디스크립터 추가 실패 시 열었던 파일 닫기
+        file_close(f);  // 파일 디스크립터 추가 실패 시 열었던 파일 닫기
     }
 
     return fd;  // 파일 디스크립터 반환
 }
 
-// 파일 객체에 대한 파일 디스크립터를 생성하는 함수
+// 파일 객체에 대한 파일 디스크립터를 생성하는 함수.
+// 비어 있는 가장 작은 번호를 돌려주고, 테이블이 가득 차면 -1을 반환한다
 int process_add_file(struct file *f) {
-    struct thread *t = thread_current();  // 현재 실행 중인 스레드 구조체
-    struct file **fdt = t->fdt;  // 현재 스레드의 파일 디스크립터 테이블
-    int fd = t->fdidx;  // 현재 스레드의 파일 디스크립터 인덱스
-
-    // 파일 디스크립터 테이블에서 비어있는 위치를 찾아 파일을 추가한다.
-    while (t->fdt[fd] != NULL && fd < FDCOUNT_LIMIT) {
-        fd++;
-    }
-    if (fd >= FDCOUNT_LIMIT) {
-        // 파일 디스크립터 테이블이 가득찬 경우, -1을 반환한다.
-        return -1;
-    }
-
-    t->fdidx = fd;  // 다음 파일에 할당될 파일 디스크립터 인덱스 갱신
-    fdt[fd] = f;  // 파일 객체를 파일 디스크립터 테이블에 추가
-
-    return fd;  // 할당된 파일 디스크립터 반환
+    return fd_table_install(&thread_current()->fdt, FD_FILE, f);
 }
 
 // 파일 디스크립터를 사용하여 파일의 크기를 가져오는 함수
@@ -232,80 +297,26 @@ int filesize(int fd) {
     file_length(f);
 }
 
-// 주어진 파일 디스크립터를 사용하여 스레드의 파일 테이블에서 파일 객체를 찾아 반환하는 함수
+// 주어진 파일 디스크립터를 사용하여 스레드의 파일 테이블에서 파일 객체를 찾아 반환하는 함수.
+// 열려 있지 않거나 파일이 아닌 것(표준 입출력, 파이프)을 가리키는 fd면 NULL을 반환
 struct file *process_get_file(int fd) {
-    // 파일 디스크립터가 유효한 범위를 벗어나면 NULL을 반환
-    if (fd < 0 || fd >= FDCOUNT_LIMIT) {
-        return NULL;
-    }
-
-    // 현재 실행 중인 스레드의 정보를 가져옴
-    struct thread *t = thread_current();
-    // 현재 스레드의 파일 테이블을 가져옴
-    struct file **fdt = t->fdt;
+    struct open_file *of = fd_table_get(&thread_current()->fdt, fd);
 
-    // 파일 테이블에서 주어진 파일 디스크립터에 해당하는 파일 객체를 가져옴
-    struct file *file = fdt[fd];
-
-    // 찾은 파일 객체를 반환
-    return file;
+    return of != NULL && of->type == FD_FILE ? of->file : NULL;
 }
 
 
 // 주어진 파일 디스크립터를 사용하여 파일로부터 데이터를 읽어오는 함수
 int read(int fd, void *buffer, unsigned size) {
-    // 주어진 buffer의 주소 유효성을 확인
-    check_address(buffer);
-    check_address((char*)buffer + size - 1);
-
-    // buffer를 unsigned char 포인터로 캐스팅하여 사용하기 위한 변수
-    unsigned char *buf = buffer;
-    int bytes_written;
-
-    // 주어진 파일 디스크립터로부터 파일 객체를 가져옴
-    struct file *f = process_get_file(fd);
-
-    // 파일 객체가 NULL인 경우, 즉 파일을 찾을 수 없는 경우 -1을 반환
-    if (f == NULL) {
-        return -1;
-    }
-
-    if (fd == STDIN_FILENO) {
-        // 파일 디스크립터가 표준 입력인 경우, 키보드 입력을 받아 buffer에 저장
-        char key;
-        for (int bytes_written = 0; bytes_written < size; bytes_written++) {
-            key = input_getc();
-            *buf++ = key;
-            if (key == '\0') {
-                break;
-            }
-        }
-    } else if (fd == STDOUT_FILENO) {
-        // 파일 디스크립터가 표준 출력인 경우, 읽기 작업을 지원하지 않으므로 -1을 반환
-        return -1;
-    } else {
-        // 일반 파일인 경우, 파일을 읽어와서 buffer에 저장하고 읽은 바이트 수를 반환
-        lock_acquire(&filesys_lock);
-        bytes_written = file_read(f, buffer, size);
-        lock_release(&filesys_lock);
-    }
-
-    return bytes_written;
+    // fd가 가리키는 대상(키보드, 파일, 파이프)에서 읽고 읽은 바이트 수를 반환
+    return simple_io(fd, buffer, size, false);
 }
 
 // 주어진 파일 디스크립터를 사용하여 파일 내에서 지정된 위치로 이동하는 함수
 void seek(int fd, unsigned position) {
-    // 파일 디스크립터가 표준 입력 또는 표준 출력인 경우 함수 종료
-    if (fd < 2) {
-        return;
-    }
-
     // 주어진 파일 디스크립터로부터 파일 객체를 가져옴
     struct file *f = process_get_file(fd);
 
-    // 파일 객체의 주소 유효성을 확인
-    check_address(f);
-
     // 파일 객체가 NULL인 경우 함수 종료
     if (f == NULL) {
         return;
@@ -319,22 +330,9 @@ void seek(int fd, unsigned position) {
 
 // 주어진 파일 디스크립터를 사용하여 파일 내 현재 커서의 위치를 반환하는 함수
 unsigned tell(int fd) {
-    // 파일 디스크립터가 표준 입력 또는 표준 출력인 경우 함수 종료
-    if (fd < 2) {
-        return;
-    }
-
-    // 파일 디스크립터가 유효하지 않은 경우 함수 종료
-    if (fd < 0 || fd >= FDCOUNT_LIMIT) {
-        return;
-    }
-
     // 주어진 파일 디스크립터로부터 파일 객체를 가져옴
     struct file *f = process_get_file(fd);
 
-    // 파일 객체의 주소 유효성을 확인
-    check_address(f);
-
     // 파일 객체가 NULL인 경우 함수 종료
     if (f == NULL) {
         return;
@@ -345,41 +343,349 @@ unsigned tell(int fd) {
 }
 
 
-// 주어진 파일 디스크립터를 사용하여 열린 파일을 닫는 함수
+// 주어진 파일 디스크립터를 사용하여 열린 파일을 닫는 함수.
+// 같은 대상을 가리키는 다른 fd(dup2)가 남아 있으면 대상은 열린 채로 남는다
 void close(int fd) {
-    // 파일 디스크립터가 표준 입력 또는 표준 출력인 경우 함수 종료
-    if (fd < 2) {
-        return;
+    fd_table_close(&thread_current()->fdt, fd);
+}
+
+// newfd가 oldfd와 같은 대상을 가리키게 하는 시스템 콜. newfd가 열려 있으면 먼저 닫는다.
+// 두 fd는 파일 위치를 공유한다. 성공하면 newfd, 실패하면 -1을 반환
+int dup2(int oldfd, int newfd) {
+    return fd_table_dup2(&thread_current()->fdt, oldfd, newfd);
+}
+
+// 파이프를 만들어 읽는 쪽 fd를 fds[0]에, 쓰는 쪽 fd를 fds[1]에 넣는 시스템 콜. 실패하면 -1
+int pipe(int *fds) {
+    struct fd_table **fdtp = &thread_current()->fdt;
+    int kfds[2];
+
+    if (!access_ok(fds, sizeof kfds))
+        exit(-1);
+
+    struct pipe *p = pipe_create();
+    if (p == NULL)
+        return -1;
+
+    // 두 fd가 각각 읽는 쪽과 쓰는 쪽을 하나씩 가진다
+    kfds[0] = fd_table_install(fdtp, FD_PIPE_READ, p);
+    if (kfds[0] < 0) {
+        pipe_close(p, false);
+        pipe_close(p, true);
+        return -1;
+    }
+    kfds[1] = fd_table_install(fdtp, FD_PIPE_WRITE, p);
+    if (kfds[1] < 0) {
+        pipe_close(p, true);
+        fd_table_close(fdtp, kfds[0]);
+        return -1;
     }
 
-    // 주어진 파일 디스크립터로부터 파일 객체를 가져옴
-    struct file *f = process_get_file(fd);
+    if (!copy_to_user(fds, kfds, sizeof kfds))
+        exit(-1);
+    return 0;
+}
 
-    // 파일 객체의 주소 유효성을 확인
-    check_address(f);
+// 키보드에서 size 바이트까지 읽어 사용자 버퍼 ubuf에 넣고 읽은 바이트 수를 반환. '\0'을 읽으면 멈춘다
+static int read_keyboard(uint8_t *ubuf, unsigned size, bool *fault) {
+    unsigned done = 0;
 
-    // 파일 객체가 NULL인 경우 함수 종료
-    if (f == NULL) {
-        return;
+    while (done < size) {
+        char key = input_getc();
+        if (!copy_to_user(ubuf + done, &key, 1)) {
+            *fault = true;
+            break;
+        }
+        done++;
+        if (key == '\0')
+            break;
     }
+    return done;
+}
 
-    // 파일 디스크립터의 범위를 확인하여 파일 테이블 엔트리를 NULL로 설정하여 파일을 닫음
-    if (fd < 0 || fd >= FDCOUNT_LIMIT) {
-        return;
+// of가 가리키는 대상과 사용자 버퍼 ubuf 사이에서 size 바이트를 옮기고 옮긴 바이트 수를 반환한다.
+// 대상이 그 방향을 지원하지 않으면 -1. 파일과 화면은 커널 페이지를 거쳐 옮기므로
+// 필요할 때 *kbuf에 페이지를 할당하고, 해제는 호출한 쪽이 한다.
+// 잘못된 사용자 주소를 만나면 *fault를 true로 한다. 파일이면 filesys_lock을 잡은 채로 호출해야 한다
+static int fd_transfer(struct open_file *of, void *ubuf, unsigned size, bool is_write,
+                       char **kbuf, bool *fault)
+{
+    switch (of->type) {
+        case FD_STDIN:
+            return is_write ? -1 : read_keyboard(ubuf, size, fault);
+        case FD_PIPE_READ:
+            return is_write ? -1 : pipe_read(of->pipe, ubuf, size, fault);
+        case FD_PIPE_WRITE:
+            return is_write ? pipe_write(of->pipe, ubuf, size, fault) : -1;
+        case FD_STDOUT:
+        case FD_FILE:
+            if (of->type == FD_STDOUT && !is_write)
+                return -1;
+            if (*kbuf == NULL && (*kbuf = palloc_get_page(0)) == NULL)
+                return -1;
+            // 표준 출력인 경우 파일 대신 NULL을 넘겨 화면에 출력
+            if (of->type == FD_STDOUT)
+                return transfer_user(NULL, ubuf, size, -1, true, *kbuf, fault);
+            return transfer_user(of->file, ubuf, size, -1, is_write, *kbuf, fault);
     }
-    
-    thread_current()->fdt[fd] = NULL;
+    return -1;
 }
 
-int exec(const char *file_name)
+// read/write 공통 부분
+static int simple_io(int fd, void *buffer, unsigned size, bool is_write) {
+    struct open_file *of = fd_table_get(&thread_current()->fdt, fd);
+    char *kbuf = NULL;
+    bool fault = false;
+    int n;
+
+    if (of == NULL)
+        return -1;
+    // 주어진 buffer가 사용자 영역 안에 있는지만 확인. 매핑 여부는 복사할 때 page fault로 확인된다
+    if (!access_ok(buffer, size))
+        exit(-1);
+
+    if (of->type == FD_FILE)
+        lock_acquire(&filesys_lock);
+    n = fd_transfer(of, buffer, size, is_write, &kbuf, &fault);
+    if (of->type == FD_FILE)
+        lock_release(&filesys_lock);
+    if (kbuf != NULL)
+        palloc_free_page(kbuf);
+    if (fault)
+        exit(-1);
+    return n;
+}
+
+// 사용자 버퍼 ubuf와 파일 f 사이에서 size 바이트를 옮기고 옮긴 바이트 수를 반환한다.
+// 사용자 메모리는 직접 파일 코드에 넘기지 않고 커널 페이지 kbuf를 거쳐 한 페이지씩 복사한다.
+// ofs가 음수이면 파일의 현재 위치에서 읽고 쓰며 위치를 옮기고, 아니면 ofs부터 읽고 쓰며 위치는 그대로 둔다.
+// f가 NULL인 쓰기는 화면 출력이다. 잘못된 사용자 주소를 만나면 *fault를 true로 하고 멈춘다.
+// filesys_lock을 잡은 채로 호출해야 한다
+static unsigned transfer_user(struct file *f, void *ubuf, unsigned size,
+                              off_t ofs, bool is_write, char *kbuf, bool *fault)
 {
-    check_address(file_name); // file_name 포인터가 유효한지 확인합니다.
+    unsigned done = 0;
 
-    char *file_name_copy = palloc_get_page(PAL_ZERO); // 페이지 할당을 통해 파일 이름을 복사할 메모리 공간을 얻습니다.
-    if (file_name_copy == NULL)
-        exit(-1); // 메모리 할당에 실패한 경우, -1을 반환하고 현재 프로세스를 종료합니다.
+    while (done < size) {
+        unsigned chunk = size - done < PGSIZE ? size - done : PGSIZE;
+        char *ucur = (char *) ubuf + done;
+        off_t n;
 
-    strlcpy(file_name_copy, file_name, PGSIZE); // file_name을 file_name_copy로 복사합니다. PGSIZE는 복사할 최대 크기를 나타냅니다.
+        if (is_write) {
+            if (!copy_from_user(kbuf, ucur, chunk)) {
+                *fault = true;
+                break;
+            }
+            if (f == NULL) {
+                putbuf(kbuf, chunk);
+                n = chunk;
+            } else if (ofs < 0) {
+                n = file_write(f, kbuf, chunk);
+            } else {
+                n = file_write_at(f, kbuf, chunk, ofs + done);
+            }
+        } else {
+            n = ofs < 0 ? file_read(f, kbuf, chunk) : file_read_at(f, kbuf, chunk, ofs + done);
+            if (!copy_to_user(ucur, kbuf, n)) {
+                *fault = true;
+                break;
+            }
+        }
+        done += n;
+        // 파일 끝에 닿아 덜 옮겨졌으면 중단
+        if ((unsigned) n < chunk)
+            break;
+    }
+    return done;
+}
+
+// readv/writev 공통 부분. iov 배열의 버퍼들을 차례로 한 번의 lock 안에서 옮긴다
+static int vectored_io(int fd, const struct iovec *uiov, int iovcnt, bool is_write)
+{
+    struct open_file *of = fd_table_get(&thread_current()->fdt, fd);
+    char *kbuf = NULL;
+    unsigned total = 0;
+    bool fault = false;
+    int i;
+
+    if (of == NULL || iovcnt < 0 || iovcnt > IOV_MAX)
+        return -1;
+    if (!access_ok(uiov, iovcnt * sizeof *uiov))
+        exit(-1);
+
+    // 파일이면 lock은 배열 전체에 대해 한 번만 잡는다
+    if (of->type == FD_FILE)
+        lock_acquire(&filesys_lock);
+    for (i = 0; i < iovcnt && !fault; i++) {
+        struct iovec iov;
+        int n;
+
+        // iovec 한 칸도 사용자 메모리이므로 복사해서 쓴다
+        if (!copy_from_user(&iov, &uiov[i], sizeof iov) || !access_ok(iov.iov_base, iov.iov_len)) {
+            fault = true;
+            break;
+        }
+        n = fd_transfer(of, iov.iov_base, iov.iov_len, is_write, &kbuf, &fault);
+        // 지원하지 않는 방향이거나 끊긴 파이프면 처음에만 -1을 돌려준다
+        if (n < 0) {
+            if (total == 0)
+                total = -1;
+            break;
+        }
+        total += n;
+        if ((unsigned) n < iov.iov_len)
+            break;
+    }
+    if (of->type == FD_FILE)
+        lock_release(&filesys_lock);
+    if (kbuf != NULL)
+        palloc_free_page(kbuf);
+
+    if (fault)
+        exit(-1);
+    return total;
+}
+
+// 여러 버퍼로 한 번에 읽는 시스템 콜
+int readv(int fd, const struct iovec *iov, int iovcnt) {
+    return vectored_io(fd, iov, iovcnt, false);
+}
+
+// 여러 버퍼를 한 번에 쓰는 시스템 콜
+int writev(int fd, const struct iovec *iov, int iovcnt) {
+    return vectored_io(fd, iov, iovcnt, true);
+}
+
+// pread/pwrite 공통 부분. 파일 위치를 바꾸지 않고 offset에서 읽고 쓴다
+static int positioned_io(int fd, void *buffer, unsigned size, off_t offset, bool is_write)
+{
+    struct file *f = process_get_file(fd);
+    bool fault = false;
+    unsigned done;
+
+    if (f == NULL || offset < 0)
+        return -1;
+    if (!access_ok(buffer, size))
+        exit(-1);
+
+    char *kbuf = palloc_get_page(0);
+    if (kbuf == NULL)
+        return -1;
+
+    lock_acquire(&filesys_lock);
+    done = transfer_user(f, buffer, size, offset, is_write, kbuf, &fault);
+    lock_release(&filesys_lock);
+    palloc_free_page(kbuf);
+
+    if (fault)
+        exit(-1);
+    return done;
+}
+
+// offset 위치에서 읽는 시스템 콜
+int pread(int fd, void *buffer, unsigned size, off_t offset) {
+    return positioned_io(fd, buffer, size, offset, false);
+}
+
+// offset 위치에 쓰는 시스템 콜
+int pwrite(int fd, const void *buffer, unsigned size, off_t offset) {
+    return positioned_io(fd, (void *) buffer, size, offset, true);
+}
+
+#ifdef VM
+// fd가 가리키는 파일을 addr에 매핑하는 시스템 콜. 실패하면 NULL(MAP_FAILED)을 반환
+void *mmap(void *addr, size_t length, int writable, int fd, off_t offset) {
+    // 표준 입출력과 파이프는 매핑할 수 없다
+    struct file *f = process_get_file(fd);
+    if (f == NULL)
+        return NULL;
+
+    // 주소, 길이, 오프셋 검사와 페이지 생성은 do_mmap이 맡는다
+    return do_mmap(addr, length, writable, f, offset);
+}
+
+// addr에서 시작하는 매핑을 해제하는 시스템 콜. 수정된 페이지는 파일에 기록된다
+void munmap(void *addr) {
+    do_munmap(addr);
+}
+
+// io_setup이 링 페이지를 놓는 주소. 스택 맨 위 바로 위쪽 페이지라 다른 매핑과 겹치지 않는다
+#define IO_RING_ADDR ((void *) USER_STACK)
+
+// 제출/완료 링 한 페이지를 프로세스에 매핑하고 주소를 반환하는 시스템 콜. 이미 있으면 그대로 반환
+struct io_ring *io_setup(void) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
+
+    // 익명 페이지는 0으로 채워져 있으므로 링의 head/tail은 0에서 시작한다
+    if (spt_find_page(spt, IO_RING_ADDR) != NULL)
+        return IO_RING_ADDR;
+    if (!vm_alloc_page(VM_ANON, IO_RING_ADDR, true) || !vm_claim_page(IO_RING_ADDR))
+        return NULL;
+    return IO_RING_ADDR;
+}
+
+// 요청 하나를 해당 시스템 콜 함수로 처리하고 그 반환값을 돌려준다
+static int64_t io_ring_execute(const struct io_sqe *sqe) {
+    switch (sqe->opcode) {
+        case IO_OP_NOP:
+            return 0;
+        case IO_OP_READ:
+            return read(sqe->fd, (void *) sqe->addr, sqe->len);
+        case IO_OP_WRITE:
+            return write(sqe->fd, (const void *) sqe->addr, sqe->len);
+        case IO_OP_SEEK:
+            seek(sqe->fd, sqe->off);
+            return 0;
+        case IO_OP_OPEN:
+            return open((const char *) sqe->addr);
+        case IO_OP_CLOSE:
+            close(sqe->fd);
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+// 제출 링에 쌓인 요청을 최대 to_submit개까지 한 번의 시스템 콜로 처리하는 시스템 콜.
+// 결과는 완료 링에 올리고, 처리한 요청 수를 반환한다. 완료 링이 가득 차면 멈춘다
+int io_enter(unsigned to_submit) {
+    struct io_ring *ring = IO_RING_ADDR;
+    uint32_t idx[4];  // sq_head, sq_tail, cq_head, cq_tail
+    unsigned done = 0;
+
+    if (spt_find_page(&thread_current()->spt, IO_RING_ADDR) == NULL)
+        return -1;
+    // 링은 사용자 메모리이므로 head/tail도 복사해서 읽고 쓴다
+    if (!copy_from_user(idx, ring, sizeof idx))
+        exit(-1);
+
+    while (done < to_submit && idx[0] != idx[1]
+           && idx[3] - idx[2] < IO_RING_ENTRIES) {
+        struct io_sqe sqe;
+        struct io_cqe cqe;
+
+        if (!copy_from_user(&sqe, &ring->sq[idx[0] % IO_RING_ENTRIES], sizeof sqe))
+            exit(-1);
+        cqe.user_data = sqe.user_data;
+        cqe.res = io_ring_execute(&sqe);
+        if (!copy_to_user(&ring->cq[idx[3] % IO_RING_ENTRIES], &cqe, sizeof cqe))
+            exit(-1);
+        idx[0]++;
+        idx[3]++;
+        done++;
+    }
+
+    // 커널 몫인 sq_head와 cq_tail만 되돌려 쓴다
+    if (!copy_to_user(&ring->sq_head, &idx[0], sizeof idx[0])
+        || !copy_to_user(&ring->cq_tail, &idx[3], sizeof idx[3]))
+        exit(-1);
+    return done;
+}
+#endif
+
+int exec(const char *file_name)
+{
+    char *file_name_copy = copy_in_string(file_name); // file_name을 커널 페이지로 복사합니다. 잘못된 주소면 종료합니다.
 
     if (process_exec(file_name_copy) == -1)
         exit(-1); // process_exec 함수를 호출하여 파일을 실행합니다. 실행에 실패한 경우, -1을 반환하고 현재 프로세스를 종료합니다.
@@ -387,8 +693,66 @@ int exec(const char *file_name)
 
 tid_t fork(const char *thread_name, struct intr_frame *f)
 {	
+    char *name = copy_in_string(thread_name); // 스레드 이름을 커널로 복사합니다.
+
 	// 현재 프로세스를 포크하여 새로운 자식 프로세스를 생성하는 process_fork 함수를 호출하고 그 결과를 반환합니다.
-    return process_fork(thread_name, f); 
+    tid_t tid = process_fork(name, f);
+    palloc_free_page(name);
+    return tid;
+}
+
+// FILE을 실행하는 자식 프로세스를 만든다. ARGV는 NULL로 끝나는 인자 문자열 포인터 배열이다.
+// 인자들은 '\0'으로 구분해 한 페이지에 이어 붙여 넘긴다. 한 페이지를 넘으면 -1을 반환한다
+int spawn(const char *file, char *const argv[])
+{
+    char *name = copy_in_string(file);
+    char *args = palloc_get_page(0);
+    size_t len = 0;
+    tid_t tid = TID_ERROR;
+
+    if (args == NULL) {
+        palloc_free_page(name);
+        return -1;
+    }
+
+    for (int i = 0; ; i++) {
+        char *arg;
+        int n;
+
+        if (!copy_from_user(&arg, &argv[i], sizeof arg)) {
+            palloc_free_page(args);
+            palloc_free_page(name);
+            exit(-1);
+        }
+        if (arg == NULL)
+            break;
+
+        n = strncpy_from_user(args + len, arg, PGSIZE - len);
+        if (n < 0) {
+            palloc_free_page(args);
+            palloc_free_page(name);
+            exit(-1);
+        }
+        if ((size_t) n == PGSIZE - len)
+            goto done;
+        len += n + 1;
+    }
+    tid = process_spawn(name, args, len);
+
+done:
+    palloc_free_page(args);
+    palloc_free_page(name);
+    return tid;
+}
+
+// 부모의 주소 공간을 빌려 쓰는 자식을 만든다. 자식이 exec하거나 종료할 때까지 부모는 돌아오지 않는다
+int vfork(const char *thread_name, struct intr_frame *f)
+{
+    char *name = copy_in_string(thread_name);
+
+    tid_t tid = process_vfork(name, f);
+    palloc_free_page(name);
+    return tid;
 }
 
 
@@ -396,14 +760,30 @@ int wait(tid_t pid) {
     return process_wait(pid);  // 내부 커널 로직 호출
 }
 
+// 아무 자식이나 종료되기를 기다려 그 pid를 반환하고, STATUS가 NULL이 아니면 종료 상태를 저장한다
+int wait_any(int *status) {
+    int st;
+    tid_t tid = process_wait_any(&st);
+
+    if (tid != TID_ERROR && status != NULL && !copy_to_user(status, &st, sizeof st))
+        exit(-1);
+    return tid;
+}
+
 
 
-void check_address(void* addr)
+// 사용자 문자열을 새 커널 페이지로 복사해서 반환한다.
+// 잘못된 주소이거나 한 페이지에 들어가지 않으면 프로세스를 종료한다. 호출자가 palloc_free_page로 해제한다
+static char *copy_in_string(const char *ustr)
 {
-	if(addr == NULL) //null 포인터
-		exit(-1);
-	if(!is_user_vaddr(addr)) //매핑되지 않은 가상 메모리를 가리키는 포인터
-		exit(-1);
-	if(pml4_get_page(thread_current() -> pml4, addr) == NULL) //커널 가상 주소 공간을 가리키는 포인터터
-		exit(-1);
-}
\ No newline at end of file
+    char *kstr = palloc_get_page(0);
+    if (kstr == NULL)
+        exit(-1);
+
+    int len = strncpy_from_user(kstr, ustr, PGSIZE);
+    if (len < 0 || len == PGSIZE) {
+        palloc_free_page(kstr);
+        exit(-1);
+    }
+    return kstr;
+}
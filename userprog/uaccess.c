@@ -0,0 +1,118 @@
+#include "userprog/uaccess.h"
+#include "threads/vaddr.h"
+
+/* Access to user memory from the kernel.
+ *
+ * The kernel reads and writes user buffers in place, without first
+ * walking the page table to see whether they are mapped.  Each
+ * instruction below that touches user memory is listed in the
+ * exception table, the __ex_table section, together with a fixup
+ * address.  If the access faults and the fault cannot be resolved by
+ * the VM system, page_fault() resumes at the fixup, and the function
+ * reports failure instead of the kernel dying.  Pages that are merely
+ * not loaded yet fault in as they would for the process itself.
+ *
+ * The caller still has to keep kernel addresses out, which is what
+ * access_ok() is for: the fixups only cover faults, and a user
+ * pointer into kernel space would not fault. */
+
+/* An entry of the exception table: a fault at INSN resumes at FIXUP. */
+struct exception_table_entry {
+	uint64_t insn;
+	uint64_t fixup;
+};
+
+/* Bounds of the exception table, set by the linker script. */
+extern const struct exception_table_entry __start_ex_table[];
+extern const struct exception_table_entry __stop_ex_table[];
+
+/* Assembler text that adds an exception table entry. */
+#define EX_TABLE(INSN, FIXUP)                 \
+	".pushsection __ex_table, \"a\"\n"        \
+	".balign 8\n"                             \
+	".quad " INSN ", " FIXUP "\n"             \
+	".popsection\n"
+
+/* Returns true if [UADDR, UADDR + SIZE) lies entirely in user space. */
+bool
+access_ok (const void *uaddr, size_t size) {
+	return is_user_vaddr (uaddr)
+		&& size <= (uint64_t) KERN_BASE - (uint64_t) uaddr;
+}
+
+/* Copies SIZE bytes from SRC to DST, either of which may be in user
+ * space.  Returns the number of bytes left uncopied when a fault cut
+ * the copy short, so 0 on success.  A fault inside "rep movsb" leaves
+ * the remaining count in rcx. */
+static size_t
+copy_user (void *dst, const void *src, size_t size) {
+	__asm __volatile (
+			"1: rep movsb\n"
+			"2:\n"
+			EX_TABLE ("1b", "2b")
+			: "+c" (size), "+D" (dst), "+S" (src) : : "memory");
+	return size;
+}
+
+/* Reads the byte at user address UADDR.  Returns the byte, or -1 if the
+ * access faulted. */
+static int
+get_user (const uint8_t *uaddr) {
+	int result;
+	__asm __volatile (
+			"1: movzbl %1, %0\n"
+			"   jmp 3f\n"
+			"2: movl $-1, %0\n"
+			"3:\n"
+			EX_TABLE ("1b", "2b")
+			: "=&r" (result) : "m" (*uaddr));
+	return result;
+}
+
+/* Copies SIZE bytes from user address USRC to DST.  Returns true if
+ * successful, false if part of the source is not accessible. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size) {
+	return access_ok (usrc, size) && copy_user (dst, usrc, size) == 0;
+}
+
+/* Copies SIZE bytes from SRC to user address UDST.  Returns true if
+ * successful, false if part of the destination is not writable. */
+bool
+copy_to_user (void *udst, const void *src, size_t size) {
+	return access_ok (udst, size) && copy_user (udst, src, size) == 0;
+}
+
+/* Copies the null-terminated string at user address USRC into DST, a
+ * buffer of SIZE bytes.  Returns the length of the string, not counting
+ * the null terminator, or -1 if it is not accessible.  If the string
+ * does not fit, SIZE is returned and DST is not null-terminated. */
+int
+strncpy_from_user (char *dst, const char *usrc, size_t size) {
+	const uint8_t *src = (const uint8_t *) usrc;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		int c;
+
+		if (!is_user_vaddr (src + i) || (c = get_user (src + i)) < 0)
+			return -1;
+		dst[i] = c;
+		if (c == '\0')
+			return i;
+	}
+	return size;
+}
+
+/* Returns the fixup address for a fault at RIP, or 0 if RIP is not an
+ * instruction allowed to fault on user memory.  The table has only a
+ * handful of entries, all from this file, so a linear scan will do. */
+uint64_t
+search_exception_table (uint64_t rip) {
+	const struct exception_table_entry *e;
+
+	for (e = __start_ex_table; e < __stop_ex_table; e++)
+		if (e->insn == rip)
+			return e->fixup;
+	return 0;
+}
@@ -2,6 +2,7 @@
 
 #include "vm/vm.h"
 #include "devices/disk.h"
+#include "threads/palloc.h"
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -27,10 +28,17 @@ vm_anon_init (void) {
 /* Initialize the file mapping */
 bool
 anon_initializer (struct page *page, enum vm_type type, void *kva) {
+	/* Frames come from the user pool unzeroed, so a page with no
+	 * initializer to fill it is cleared here instead of showing what the
+	 * frame's last owner left.  Read UNINIT before the union is reused. */
+	if (page->uninit.init == NULL)
+		clear_page (kva);
+
 	/* Set up the handler */
 	page->operations = &anon_ops;
 
-	struct anon_page *anon_page = &page->anon;
+	struct anon_page *anon_page UNUSED = &page->anon;
+	return true;
 }
 
 /* Swap in the page by read contents from the swap disk. */
@@ -48,5 +56,6 @@ anon_swap_out (struct page *page) {
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
-	struct anon_page *anon_page = &page->anon;
+	struct anon_page *anon_page UNUSED = &page->anon;
+	vm_free_frame (page);
 }
@@ -1,5 +1,11 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
+#include <round.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
 #include "vm/vm.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
@@ -14,9 +20,33 @@ static const struct page_operations file_ops = {
 	.type = VM_FILE,
 };
 
+/* A page of a file held in memory while any process has it mmap'd.  Every
+ * mapping of the page, in every process, maps this single copy, so file
+ * data is never duplicated between mappers.  Whether it was written is
+ * read off the dirty bits of the mappers' PTEs at writeback. */
+struct file_cache_page {
+	struct hash_elem elem;      /* Element in file_cache. */
+	struct inode *inode;        /* File the page belongs to. */
+	off_t ofs;                  /* Offset of the page in the file. */
+	struct file *file;          /* Own reference, for writeback. */
+	uint32_t read_bytes;        /* Bytes of the page inside the file. */
+	void *kva;                  /* The page itself. */
+	struct list mappers;        /* Pages mapping it, by file.cache_elem. */
+};
+
+/* Cached file pages keyed by inode and offset. */
+static struct hash file_cache;
+static struct lock file_cache_lock;
+
+static uint64_t file_cache_hash (const struct hash_elem *e, void *aux);
+static bool file_cache_less (const struct hash_elem *a,
+		const struct hash_elem *b, void *aux);
+
 /* The initializer of file vm */
 void
 vm_file_init (void) {
+	hash_init (&file_cache, file_cache_hash, file_cache_less, NULL);
+	lock_init (&file_cache_lock);
 }
 
 /* Initialize the file backed page */
@@ -26,6 +56,128 @@ file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
 	page->operations = &file_ops;
 
 	struct file_page *file_page = &page->file;
+	file_page->cache = NULL;
+	file_page->pml4 = NULL;
+	return true;
+}
+
+/* Completes the initialization of an mmap'd PAGE from AUX, a struct
+ * lazy_load_aux whose file reference PAGE takes over. */
+static bool
+mmap_init (struct page *page, void *aux_) {
+	struct lazy_load_aux *aux = aux_;
+	struct file_page *file_page = &page->file;
+
+	file_page->file = aux->file;
+	file_page->ofs = aux->ofs;
+	file_page->read_bytes = aux->read_bytes;
+	file_page->map_pages = aux->map_pages;
+	free (aux);
+	return true;
+}
+
+/* Returns the cached page of FILE at OFS, reading it in if no one has it
+ * mapped yet.  Returns a null pointer if memory runs out.  Must be called
+ * with file_cache_lock held. */
+static struct file_cache_page *
+file_cache_get (struct file *file, off_t ofs) {
+	struct file_cache_page key, *cp;
+	struct hash_elem *e;
+	off_t read_bytes;
+
+	key.inode = file_get_inode (file);
+	key.ofs = ofs;
+	e = hash_find (&file_cache, &key.elem);
+	if (e != NULL)
+		return hash_entry (e, struct file_cache_page, elem);
+
+	cp = malloc (sizeof *cp);
+	if (cp == NULL)
+		return NULL;
+	cp->kva = palloc_get_page (PAL_USER);
+	cp->file = file_reopen (file);
+	if (cp->kva == NULL || cp->file == NULL)
+		goto fail;
+
+	read_bytes = file_read_at (cp->file, cp->kva, PGSIZE, ofs);
+	if (read_bytes < 0)
+		goto fail;
+	memset ((uint8_t *) cp->kva + read_bytes, 0, PGSIZE - read_bytes);
+	cp->read_bytes = read_bytes;
+	cp->inode = key.inode;
+	cp->ofs = ofs;
+	list_init (&cp->mappers);
+	hash_insert (&file_cache, &cp->elem);
+	return cp;
+
+fail:
+	if (cp->kva != NULL)
+		palloc_free_page (cp->kva);
+	file_close (cp->file);
+	free (cp);
+	return NULL;
+}
+
+/* Frees CP once nothing maps it any more.  Must be called with
+ * file_cache_lock held. */
+static void
+file_cache_put (struct file_cache_page *cp) {
+	if (!list_empty (&cp->mappers))
+		return;
+	hash_delete (&file_cache, &cp->elem);
+	file_close (cp->file);
+	palloc_free_page (cp->kva);
+	free (cp);
+}
+
+/* Writes CP back to its file if any of its mappers dirtied it, and marks
+ * it clean in all of them.  Must be called with file_cache_lock held. */
+static void
+file_cache_writeback (struct file_cache_page *cp) {
+	bool dirty = false;
+	struct list_elem *e;
+
+	for (e = list_begin (&cp->mappers); e != list_end (&cp->mappers);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, file.cache_elem);
+
+		if (pml4_is_dirty (page->file.pml4, page->va)) {
+			pml4_set_dirty (page->file.pml4, page->va, false);
+			dirty = true;
+		}
+	}
+	if (dirty)
+		file_write_at (cp->file, cp->kva, cp->read_bytes, cp->ofs);
+}
+
+/* Maps the cached copy of mmap'd PAGE into the current process, setting
+ * PAGE up first if this is its first fault.  Returns true if successful,
+ * false if memory runs out. */
+bool
+file_backed_map (struct page *page) {
+	struct file_page *file_page = &page->file;
+	uint64_t *pml4 = thread_current ()->pml4;
+	struct file_cache_page *cp;
+
+	if (VM_TYPE (page->operations->type) == VM_UNINIT
+			&& !swap_in (page, NULL))
+		return false;
+	ASSERT (file_page->cache == NULL);
+
+	lock_acquire (&file_cache_lock);
+	cp = file_cache_get (file_page->file, file_page->ofs);
+	if (cp != NULL) {
+		if (pml4_set_page (pml4, page->va, cp->kva, page->writable)) {
+			list_push_back (&cp->mappers, &file_page->cache_elem);
+			file_page->cache = cp;
+			file_page->pml4 = pml4;
+		} else {
+			file_cache_put (cp);
+			cp = NULL;
+		}
+	}
+	lock_release (&file_cache_lock);
+	return cp != NULL;
 }
 
 /* Swap in the page by read contents from the file. */
@@ -43,16 +195,132 @@ file_backed_swap_out (struct page *page) {
 /* Destory the file backed page. PAGE will be freed by the caller. */
 static void
 file_backed_destroy (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+	struct file_cache_page *cp = file_page->cache;
+
+	if (cp != NULL) {
+		lock_acquire (&file_cache_lock);
+		file_cache_writeback (cp);
+		pml4_clear_page (file_page->pml4, page->va);
+		list_remove (&file_page->cache_elem);
+		file_cache_put (cp);
+		lock_release (&file_cache_lock);
+		file_page->cache = NULL;
+	}
+	file_close (file_page->file);
+}
+
+/* Creates the lazy page that maps a page of FILE at OFS at UPAGE in the
+ * current process.  MAP_PAGES is nonzero only for the first page of a
+ * mapping.  Takes its own reference to FILE. */
+static bool
+mmap_alloc_page (void *upage, bool writable, struct file *file, off_t ofs,
+		uint32_t read_bytes, size_t map_pages) {
+	struct lazy_load_aux *aux = malloc (sizeof *aux);
+	if (aux == NULL)
+		return false;
+
+	aux->file = file_reopen (file);
+	aux->ofs = ofs;
+	aux->read_bytes = read_bytes;
+	aux->map_pages = map_pages;
+	if (aux->file == NULL
+			|| !vm_alloc_page_with_initializer (VM_FILE | VM_FILE_AUX, upage,
+				writable, mmap_init, aux)) {
+		file_close (aux->file);
+		free (aux);
+		return false;
+	}
+	return true;
+}
+
+/* Gives the current process, a child being forked, the mapping that PAGE
+ * of its parent is part of.  Both end up mapping the same cached page. */
+bool
+file_backed_fork (struct page *page) {
+	struct file_page *file_page = &page->file;
+
+	return mmap_alloc_page (page->va, page->writable, file_page->file,
+			file_page->ofs, file_page->read_bytes, file_page->map_pages);
+}
+
+/* Returns the number of pages in the mapping that starts at PAGE, or 0
+ * if PAGE does not start one. */
+static size_t
+mmap_page_cnt (struct page *page) {
+	if (page == NULL || page_get_type (page) != VM_FILE)
+		return 0;
+	if (VM_TYPE (page->operations->type) == VM_UNINIT)
+		return ((struct lazy_load_aux *) page->uninit.aux)->map_pages;
+	return page->file.map_pages;
 }
 
 /* Do the mmap */
 void *
 do_mmap (void *addr, size_t length, int writable,
 		struct file *file, off_t offset) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	off_t file_len = file_length (file);
+	size_t page_cnt = DIV_ROUND_UP (length, PGSIZE);
+	uint8_t *upage = addr;
+	size_t i;
+
+	if (addr == NULL || pg_ofs (addr) != 0 || length == 0
+			|| offset < 0 || offset % PGSIZE != 0 || file_len == 0)
+		return NULL;
+	if (!is_user_vaddr (addr)
+			|| page_cnt > (KERN_BASE - (uint64_t) addr) / PGSIZE)
+		return NULL;
+	for (i = 0; i < page_cnt; i++)
+		if (spt_find_page (spt, upage + i * PGSIZE) != NULL)
+			return NULL;
+
+	for (i = 0; i < page_cnt; i++) {
+		off_t ofs = offset + i * PGSIZE;
+		uint32_t read_bytes = ofs < file_len ? file_len - ofs : 0;
+
+		if (read_bytes > PGSIZE)
+			read_bytes = PGSIZE;
+		if (!mmap_alloc_page (upage + i * PGSIZE, writable, file, ofs,
+					read_bytes, i == 0 ? page_cnt : 0)) {
+			while (i-- > 0)
+				spt_remove_page (spt, spt_find_page (spt, upage + i * PGSIZE));
+			return NULL;
+		}
+	}
+	return addr;
 }
 
 /* Do the munmap */
 void
 do_munmap (void *addr) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	size_t page_cnt = mmap_page_cnt (spt_find_page (spt, addr));
+	uint8_t *upage = addr;
+	size_t i;
+
+	for (i = 0; i < page_cnt; i++)
+		spt_remove_page (spt, spt_find_page (spt, upage + i * PGSIZE));
+}
+
+/* Returns a hash value for the cached page that E belongs to. */
+static uint64_t
+file_cache_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct file_cache_page *cp =
+		hash_entry (e, struct file_cache_page, elem);
+	return hash_bytes (&cp->inode, sizeof cp->inode) ^ hash_int (cp->ofs);
+}
+
+/* Returns true if cached page A precedes cached page B. */
+static bool
+file_cache_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct file_cache_page *a =
+		hash_entry (a_, struct file_cache_page, elem);
+	const struct file_cache_page *b =
+		hash_entry (b_, struct file_cache_page, elem);
+
+	if (a->inode != b->inode)
+		return a->inode < b->inode;
+	return a->ofs < b->ofs;
 }
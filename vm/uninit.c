@@ -10,6 +10,7 @@
 
 #include "vm/vm.h"
 #include "vm/uninit.h"
+#include "threads/malloc.h"
 
 static bool uninit_initialize (struct page *page, void *kva);
 static void uninit_destroy (struct page *page);
@@ -48,12 +49,21 @@ uninit_initialize (struct page *page, void *kva) {
 	struct uninit_page *uninit = &page->uninit;
 
 	/* Fetch first, page_initialize may overwrite the values */
+	struct uninit_page saved = *uninit;
 	vm_initializer *init = uninit->init;
 	void *aux = uninit->aux;
 
-	/* TODO: You may need to fix this function. */
-	return uninit->page_initializer (page, uninit->type, kva) &&
-		(init ? init (page, aux) : true);
+	if (!uninit->page_initializer (page, uninit->type, kva))
+		return false;
+	if (init != NULL && !init (page, aux)) {
+		/* The contents never arrived: leave the page unloaded, so that
+		 * the next fault on it tries again instead of finding a resident
+		 * page that reads back as garbage.  INIT keeps AUX on failure. */
+		page->operations = &uninit_ops;
+		page->uninit = saved;
+		return false;
+	}
+	return true;
 }
 
 /* Free the resources hold by uninit_page. Although most of pages are transmuted
@@ -62,7 +72,13 @@ uninit_initialize (struct page *page, void *kva) {
  * PAGE will be freed by the caller. */
 static void
 uninit_destroy (struct page *page) {
-	struct uninit_page *uninit UNUSED = &page->uninit;
-	/* TODO: Fill this function.
-	 * TODO: If you don't have anything to do, just return. */
+	struct uninit_page *uninit = &page->uninit;
+
+	/* A page that was only read may still map the zero page. */
+	vm_free_frame (page);
+	if (uninit->type & VM_FILE_AUX) {
+		struct lazy_load_aux *aux = uninit->aux;
+		file_close (aux->file);
+		free (aux);
+	}
 }
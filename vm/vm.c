@@ -1,9 +1,50 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <stdio.h>
+#include <string.h>
 #include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/trace.h"
+#include "threads/vaddr.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
 
+/* Fault-around window, in pages, including the faulting page.  An isolated
+ * fault maps FAULT_AROUND_MIN pages; each fault that continues a sequential
+ * walk doubles the window up to FAULT_AROUND_MAX. */
+#define FAULT_AROUND_MIN 2
+#define FAULT_AROUND_MAX 16
+
+/* A stack access may fault this many bytes below rsp: push and call check
+ * the destination before they move the stack pointer. */
+#define STACK_SLACK 8
+
+/* Pages mapped past the faulting one by a stack growth event.  Each event
+ * doubles the batch, so deep recursion takes a handful of faults. */
+#define STACK_BATCH_MIN 1
+#define STACK_BATCH_MAX 16
+
+/* Maximum size of a user stack, in pages. */
+size_t stack_page_limit = (1 << 20) / PGSIZE;
+
+/* Every frame handed out to a user page. */
+static struct list frame_table;
+static struct lock frame_lock;
+
+/* A page of zeros shared read-only by every anonymous page that has been
+ * read but never written. */
+static void *zero_page;
+
+/* Statistics. */
+static long long fault_cnt;         /* # of faults resolved. */
+static long long fault_around_cnt;  /* # of pages mapped by fault-around. */
+static long long fault_avoid_cnt;   /* # of those the process touched. */
+static long long stack_grow_cnt;    /* # of stack growth events. */
+static long long stack_page_cnt;    /* # of pages they mapped. */
+static long long zero_map_cnt;      /* # of reads served by the zero page. */
+static long long zero_copy_cnt;     /* # of those later written. */
+
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void
@@ -15,7 +56,20 @@ vm_init (void) {
 #endif
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
-	/* TODO: Your code goes here. */
+	list_init (&frame_table);
+	lock_init (&frame_lock);
+	zero_page = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+}
+
+/* Prints virtual memory statistics. */
+void
+vm_print_stats (void) {
+	printf ("VM: %lld faults, %lld pages faulted around, %lld faults avoided\n",
+			fault_cnt, fault_around_cnt, fault_avoid_cnt);
+	printf ("VM: %lld stack growths, %lld stack pages\n",
+			stack_grow_cnt, stack_page_cnt);
+	printf ("VM: %lld zero page mappings, %lld written\n",
+			zero_map_cnt, zero_copy_cnt);
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -35,7 +89,13 @@ page_get_type (struct page *page) {
 /* Helpers */
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
+static bool vm_map_frame (struct page *page, struct frame *frame);
 static struct frame *vm_evict_frame (void);
+static bool try_handle_fault (struct intr_frame *f, void *addr,
+		bool user, bool write, bool not_present);
+static uint64_t page_hash (const struct hash_elem *e, void *aux);
+static bool page_less (const struct hash_elem *a,
+		const struct hash_elem *b, void *aux);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -50,11 +110,33 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 
 	/* Check wheter the upage is already occupied or not. */
 	if (spt_find_page (spt, upage) == NULL) {
-		/* TODO: Create the page, fetch the initialier according to the VM type,
-		 * TODO: and then create "uninit" page struct by calling uninit_new. You
-		 * TODO: should modify the field after calling the uninit_new. */
-
-		/* TODO: Insert the page into the spt. */
+		bool (*initializer) (struct page *, enum vm_type, void *);
+		struct page *page;
+
+		switch (VM_TYPE (type)) {
+			case VM_ANON:
+				initializer = anon_initializer;
+				break;
+			case VM_FILE:
+				initializer = file_backed_initializer;
+				break;
+			default:
+				goto err;
+		}
+
+		page = malloc (sizeof *page);
+		if (page == NULL)
+			goto err;
+		uninit_new (page, upage, init, type, aux, initializer);
+		page->writable = writable;
+		page->prefetched = false;
+		page->zero_mapped = false;
+
+		if (!spt_insert_page (spt, page)) {
+			free (page);
+			goto err;
+		}
+		return true;
 	}
 err:
 	return false;
@@ -62,27 +144,26 @@ err:
 
 /* Find VA from spt and return page. On error, return NULL. */
 struct page *
-spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function. */
+spt_find_page (struct supplemental_page_table *spt, void *va) {
+	struct page p;
+	struct hash_elem *e;
 
-	return page;
+	p.va = pg_round_down (va);
+	e = hash_find (&spt->pages, &p.spt_elem);
+	return e != NULL ? hash_entry (e, struct page, spt_elem) : NULL;
 }
 
 /* Insert PAGE into spt with validation. */
 bool
-spt_insert_page (struct supplemental_page_table *spt UNUSED,
-		struct page *page UNUSED) {
-	int succ = false;
-	/* TODO: Fill this function. */
-
-	return succ;
+spt_insert_page (struct supplemental_page_table *spt,
+		struct page *page) {
+	return hash_insert (&spt->pages, &page->spt_elem) == NULL;
 }
 
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
+	hash_delete (&spt->pages, &page->spt_elem);
 	vm_dealloc_page (page);
-	return true;
 }
 
 /* Get the struct frame, that will be evicted. */
@@ -104,40 +185,289 @@ vm_evict_frame (void) {
 	return NULL;
 }
 
+/* palloc() and get frame without evicting anything.  Returns NULL if the
+ * user pool is exhausted.  Used for speculative mappings, which are never
+ * worth an eviction. */
+static struct frame *
+vm_try_get_frame (void) {
+	struct frame *frame = malloc (sizeof *frame);
+	if (frame == NULL)
+		return NULL;
+
+	frame->kva = palloc_get_page (PAL_USER);
+	if (frame->kva == NULL) {
+		free (frame);
+		return NULL;
+	}
+	frame->page = NULL;
+
+	lock_acquire (&frame_lock);
+	list_push_back (&frame_table, &frame->frame_elem);
+	lock_release (&frame_lock);
+	return frame;
+}
+
 /* palloc() and get frame. If there is no available page, evict the page
  * and return it. This always return valid address. That is, if the user pool
  * memory is full, this function evicts the frame to get the available memory
  * space.*/
 static struct frame *
 vm_get_frame (void) {
-	struct frame *frame = NULL;
-	/* TODO: Fill this function. */
+	struct frame *frame = vm_try_get_frame ();
+	if (frame == NULL)
+		frame = vm_evict_frame ();
 
 	ASSERT (frame != NULL);
 	ASSERT (frame->page == NULL);
 	return frame;
 }
 
-/* Growing the stack. */
+/* Unmaps PAGE from the current process and returns its frame, if any, to
+ * the user pool. */
+void
+vm_free_frame (struct page *page) {
+	struct frame *frame = page->frame;
+	uint64_t *pml4 = thread_current ()->pml4;
+
+	if (page->zero_mapped) {
+		if (pml4 != NULL)
+			pml4_clear_page (pml4, page->va);
+		page->zero_mapped = false;
+	}
+	if (frame == NULL)
+		return;
+
+	if (pml4 != NULL) {
+		if (page->prefetched && pml4_is_accessed (pml4, page->va))
+			fault_avoid_cnt++;
+		pml4_clear_page (pml4, page->va);
+	}
+
+	lock_acquire (&frame_lock);
+	list_remove (&frame->frame_elem);
+	lock_release (&frame_lock);
+
+	palloc_free_page (frame->kva);
+	free (frame);
+	page->frame = NULL;
+}
+
+/* Returns true if a fault on ADDR is a stack access that the stack may
+ * grow to cover.  F->rsp is the user stack pointer only for faults taken
+ * in user mode; inside a system call the one saved on entry is used. */
+static bool
+is_stack_access (struct intr_frame *f, void *addr, bool user) {
+	uint64_t rsp = user ? f->rsp : thread_current ()->user_rsp;
+	uint64_t va = (uint64_t) addr;
+
+	return va + STACK_SLACK >= rsp
+		&& va < USER_STACK
+		&& va >= USER_STACK - stack_page_limit * PGSIZE;
+}
+
+/* Growing the stack.  Maps every page between the current stack bottom
+ * and ADDR, which the process is about to use, plus a batch of pages
+ * below ADDR so a deepening stack does not fault on every page.  The batch
+ * is only mapped while free frames last.  Like any anonymous page without
+ * an initializer, each comes up zeroed by anon_initializer(). */
 static void
-vm_stack_growth (void *addr UNUSED) {
+vm_stack_growth (void *addr) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	uint8_t *limit = (uint8_t *) USER_STACK - stack_page_limit * PGSIZE;
+	uint8_t *target = pg_round_down (addr);
+	uint8_t *bottom = target;
+	uint8_t *va;
+
+	if ((size_t) (bottom - limit) / PGSIZE >= spt->stack_batch)
+		bottom -= spt->stack_batch * PGSIZE;
+	else
+		bottom = limit;
+
+	for (va = (uint8_t *) spt->stack_bottom - PGSIZE; va >= bottom;
+			va -= PGSIZE) {
+		struct frame *frame;
+		struct page *page;
+
+		if (spt_find_page (spt, va) != NULL
+				|| !vm_alloc_page (VM_ANON | VM_STACK, va, true))
+			break;
+		page = spt_find_page (spt, va);
+		frame = va >= target ? vm_get_frame () : vm_try_get_frame ();
+		if (frame == NULL || !vm_map_frame (page, frame)) {
+			spt_remove_page (spt, page);
+			break;
+		}
+		spt->stack_bottom = va;
+		stack_page_cnt++;
+	}
+
+	if (spt->stack_batch < STACK_BATCH_MAX)
+		spt->stack_batch *= 2;
+	stack_grow_cnt++;
+}
+
+/* Returns true if PAGE was never loaded and would load as all zeros, so
+ * that reading it can be served by the shared zero page.  Stack pages are
+ * written right away and do not qualify. */
+static bool
+is_zero_page (struct page *page) {
+	struct uninit_page *uninit = &page->uninit;
+
+	if (VM_TYPE (page->operations->type) != VM_UNINIT
+			|| VM_TYPE (uninit->type) != VM_ANON
+			|| (uninit->type & VM_STACK))
+		return false;
+	if (uninit->type & VM_FILE_AUX)
+		return ((struct lazy_load_aux *) uninit->aux)->read_bytes == 0;
+	return uninit->init == NULL;
+}
+
+/* Maps the shared zero page read-only at PAGE, which stays uninit until
+ * it is first written. */
+static bool
+vm_map_zero_page (struct page *page) {
+	if (!pml4_set_page (thread_current ()->pml4, page->va, zero_page, false))
+		return false;
+	page->zero_mapped = true;
+	zero_map_cnt++;
+	return true;
 }
 
 /* Handle the fault on write_protected page */
 static bool
-vm_handle_wp (struct page *page UNUSED) {
+vm_handle_wp (struct page *page) {
+	if (!page->zero_mapped)
+		return false;
+
+	/* First write to a zero page: give it a private frame.  The page is
+	 * still uninit, so loading it zeroes the frame just as the zero page
+	 * was, in anon_initializer() or in the segment loader. */
+	pml4_clear_page (thread_current ()->pml4, page->va);
+	page->zero_mapped = false;
+	zero_copy_cnt++;
+	return vm_do_claim_page (page);
+}
+
+/* Returns true if PAGE is still to be read from a file, and if so returns
+ * where from in *INODE and *OFS. */
+static bool
+fault_around_source (struct page *page, struct inode **inode, off_t *ofs) {
+	struct lazy_load_aux *aux;
+
+	if (VM_TYPE (page->operations->type) != VM_UNINIT
+			|| VM_TYPE (page->uninit.type) != VM_ANON
+			|| !(page->uninit.type & VM_FILE_AUX))
+		return false;
+	aux = page->uninit.aux;
+	*inode = aux->read_bytes > 0 ? file_get_inode (aux->file) : NULL;
+	*ofs = aux->ofs;
+	return true;
+}
+
+/* Returns true if PAGE is worth mapping along with a fault on the page
+ * DISTANCE pages below it, which was read from INODE at OFS.  Only
+ * unloaded pages of the same file that continue at the following offsets
+ * qualify, so the read stays sequential.  Zero-only pages are left to the
+ * shared zero page. */
+static bool
+fault_around_candidate (struct page *page, struct inode *inode, off_t ofs,
+		size_t distance) {
+	struct inode *next_inode;
+	off_t next_ofs;
+
+	if (page == NULL || page->frame != NULL || page->zero_mapped
+			|| !fault_around_source (page, &next_inode, &next_ofs))
+		return false;
+	return next_inode != NULL && next_inode == inode
+		&& next_ofs == ofs + (off_t) (distance * PGSIZE);
+}
+
+/* Maps the pages following PAGE, which just faulted in from INODE at OFS,
+ * so that a sequential walk takes one fault per window instead of one per
+ * page.  A fault exactly where the previous window ended is taken as a
+ * stream and doubles the window; any other fault resets it. */
+static void
+vm_fault_around (struct supplemental_page_table *spt, struct page *page,
+		struct inode *inode, off_t ofs) {
+	uint8_t *va;
+	size_t i;
+
+	if (page->va == spt->fa_next) {
+		if (spt->fa_window < FAULT_AROUND_MAX)
+			spt->fa_window *= 2;
+	} else
+		spt->fa_window = FAULT_AROUND_MIN;
+
+	va = (uint8_t *) page->va + PGSIZE;
+	for (i = 1; i < spt->fa_window; i++, va += PGSIZE) {
+		struct page *next = spt_find_page (spt, va);
+		struct frame *frame;
+
+		if (!fault_around_candidate (next, inode, ofs, i))
+			break;
+		frame = vm_try_get_frame ();
+		if (frame == NULL || !vm_map_frame (next, frame))
+			break;
+		next->prefetched = true;
+		fault_around_cnt++;
+	}
+	spt->fa_next = va;
 }
 
 /* Return true on success */
 bool
-vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
-		bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
-	struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
-	struct page *page = NULL;
-	/* TODO: Validate the fault */
-	/* TODO: Your code goes here */
+vm_try_handle_fault (struct intr_frame *f, void *addr,
+		bool user, bool write, bool not_present) {
+	bool success;
+
+	TRACE (TRACE_FAULT, addr, write);
+	success = try_handle_fault (f, addr, user, write, not_present);
+	TRACE (TRACE_FAULT_DONE, success, 0);
+	return success;
+}
 
-	return vm_do_claim_page (page);
+/* Handles a fault at ADDR for vm_try_handle_fault(). */
+static bool
+try_handle_fault (struct intr_frame *f, void *addr,
+		bool user, bool write, bool not_present) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct inode *inode = NULL;
+	struct page *page;
+	off_t ofs = 0;
+	bool around;
+
+	if (addr == NULL || is_kernel_vaddr (addr))
+		return false;
+
+	page = spt_find_page (spt, addr);
+	if (!not_present)
+		return page != NULL && write && page->writable && vm_handle_wp (page);
+	if (page == NULL && is_stack_access (f, addr, user)) {
+		vm_stack_growth (addr);
+		return spt_find_page (spt, addr) != NULL;
+	}
+	if (page == NULL || (write && !page->writable))
+		return false;
+	if (!write && is_zero_page (page))
+		return vm_map_zero_page (page);
+
+	/* Mapped files share the file's cached pages, no frame of their own. */
+	if (page_get_type (page) == VM_FILE) {
+		if (!file_backed_map (page))
+			return false;
+		fault_cnt++;
+		return true;
+	}
+
+	/* Fetch first, loading the page releases its AUX. */
+	around = fault_around_source (page, &inode, &ofs);
+	if (!vm_do_claim_page (page))
+		return false;
+	fault_cnt++;
+
+	if (around)
+		vm_fault_around (spt, page, inode, ofs);
+	return true;
 }
 
 /* Free the page.
@@ -150,9 +480,10 @@ vm_dealloc_page (struct page *page) {
 
 /* Claim the page that allocate on VA. */
 bool
-vm_claim_page (void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function */
+vm_claim_page (void *va) {
+	struct page *page = spt_find_page (&thread_current ()->spt, va);
+	if (page == NULL)
+		return false;
 
 	return vm_do_claim_page (page);
 }
@@ -160,31 +491,129 @@ vm_claim_page (void *va UNUSED) {
 /* Claim the PAGE and set up the mmu. */
 static bool
 vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
+	return vm_map_frame (page, vm_get_frame ());
+}
 
+/* Links PAGE with FRAME, maps it into the current process and loads its
+ * contents.  On failure FRAME is released. */
+static bool
+vm_map_frame (struct page *page, struct frame *frame) {
 	/* Set links */
 	frame->page = page;
 	page->frame = frame;
 
-	/* TODO: Insert page table entry to map page's VA to frame's PA. */
+	if (!pml4_set_page (thread_current ()->pml4, page->va, frame->kva,
+				page->writable) || !swap_in (page, frame->kva)) {
+		vm_free_frame (page);
+		return false;
+	}
+	return true;
+}
 
-	return swap_in (page, frame->kva);
+/* Returns a copy of AUX holding its own reference to the file. */
+static struct lazy_load_aux *
+lazy_load_aux_dup (const struct lazy_load_aux *aux) {
+	struct lazy_load_aux *copy = malloc (sizeof *copy);
+	if (copy == NULL)
+		return NULL;
+
+	*copy = *aux;
+	copy->file = file_reopen (aux->file);
+	if (copy->file == NULL) {
+		free (copy);
+		return NULL;
+	}
+	return copy;
 }
 
 /* Initialize new supplemental page table */
 void
-supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
+supplemental_page_table_init (struct supplemental_page_table *spt) {
+	hash_init (&spt->pages, page_hash, page_less, NULL);
+	spt->fa_next = NULL;
+	spt->fa_window = FAULT_AROUND_MIN;
+	spt->stack_bottom = (void *) USER_STACK;
+	spt->stack_batch = STACK_BATCH_MIN;
 }
 
 /* Copy supplemental page table from src to dst */
 bool
-supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
-		struct supplemental_page_table *src UNUSED) {
+supplemental_page_table_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	struct hash_iterator i;
+
+	hash_first (&i, &src->pages);
+	while (hash_next (&i)) {
+		struct page *page = hash_entry (hash_cur (&i), struct page, spt_elem);
+		struct page *child;
+
+		/* Pages that were never touched stay lazy in the child. */
+		if (VM_TYPE (page->operations->type) == VM_UNINIT) {
+			struct uninit_page *uninit = &page->uninit;
+			void *aux = uninit->aux;
+
+			if (uninit->type & VM_FILE_AUX) {
+				aux = lazy_load_aux_dup (aux);
+				if (aux == NULL)
+					return false;
+			}
+			if (!vm_alloc_page_with_initializer (uninit->type, page->va,
+						page->writable, uninit->init, aux)) {
+				if (uninit->type & VM_FILE_AUX) {
+					file_close (((struct lazy_load_aux *) aux)->file);
+					free (aux);
+				}
+				return false;
+			}
+			continue;
+		}
+
+		/* Mappings of files are shared with the child. */
+		if (page_get_type (page) == VM_FILE) {
+			if (!file_backed_fork (page))
+				return false;
+			continue;
+		}
+
+		/* Everything else gets a private copy of the parent's frame. */
+		if (!vm_alloc_page (VM_ANON, page->va, page->writable)
+				|| !vm_claim_page (page->va))
+			return false;
+		child = spt_find_page (dst, page->va);
+		copy_page (child->frame->kva, page->frame->kva);
+	}
+	dst->stack_bottom = src->stack_bottom;
+	dst->stack_batch = src->stack_batch;
+	return true;
+}
+
+/* Frees PAGE, which is an element of a supplemental page table. */
+static void
+spt_destroy_page (struct hash_elem *e, void *aux UNUSED) {
+	vm_dealloc_page (hash_entry (e, struct page, spt_elem));
 }
 
 /* Free the resource hold by the supplemental page table */
 void
-supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
-	/* TODO: Destroy all the supplemental_page_table hold by thread and
-	 * TODO: writeback all the modified contents to the storage. */
+supplemental_page_table_kill (struct supplemental_page_table *spt) {
+	hash_clear (&spt->pages, spt_destroy_page);
+	spt->fa_next = NULL;
+	spt->fa_window = FAULT_AROUND_MIN;
+	spt->stack_bottom = (void *) USER_STACK;
+	spt->stack_batch = STACK_BATCH_MIN;
+}
+
+/* Returns a hash value for the page that E belongs to. */
+static uint64_t
+page_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct page *page = hash_entry (e, struct page, spt_elem);
+	return hash_bytes (&page->va, sizeof page->va);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct page, spt_elem)->va
+		< hash_entry (b, struct page, spt_elem)->va;
 }